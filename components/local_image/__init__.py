@@ -1,5 +1,6 @@
 from esphome import automation
 import esphome.codegen as cg
+from esphome.components.color import ColorStruct
 
 # from esphome.components.http_request import CONF_HTTP_REQUEST_ID, HttpRequestComponent
 from esphome.components.image import (
@@ -13,16 +14,30 @@ from esphome.components.image import (
 from esphome.components.storage import FileProvider
 import esphome.config_validation as cv
 from esphome.const import (
+    CONF_BRIGHTNESS,
+    CONF_BUFFER_SIZE,
+    CONF_CONTRAST,
+    CONF_DISPLAY_ID,
     CONF_DITHER,
     CONF_FILE,
     CONF_FORMAT,
     CONF_ID,
+    CONF_INVERT,
+    CONF_LEVEL,
+    CONF_MIRROR_X,
+    CONF_MIRROR_Y,
     CONF_ON_ERROR,
     CONF_PATH,
+    CONF_PRIORITY,
     CONF_RESIZE,
+    CONF_ROTATION,
     CONF_TRIGGER_ID,
     CONF_TYPE,
+    CONF_X,
+    CONF_Y,
 )
+from esphome.core import CORE, ID
+import esphome.final_validate as fv
 
 AUTO_LOAD = ["image", "storage"]
 DEPENDENCIES = ["display"]
@@ -35,16 +50,50 @@ MULTI_CONF = True
 
 
 CONF_ON_LOAD_FINISHED = "on_load_finished"
+CONF_ON_PROGRESS = "on_progress"
 # CONF_ON_ERROR = "on_error"
 CONF_PLACEHOLDER = "placeholder"
 CONF_STORAGE_FS_ID = "storage_id"
 CONF_IMAGE_PATH = "path"
+CONF_COMPRESSION = "compression"
+CONF_PACKING = "packing"
+CONF_MASK = "mask"
+CONF_OVERLAYS = "overlays"
+CONF_TINT = "tint"
+CONF_STATISTICS = "statistics"
+CONF_PROGRESSIVE = "progressive"
+CONF_PROGRESS_INTERVAL = "progress_interval"
+CONF_FINGERPRINT = "fingerprint"
+CONF_KEEP_DECODER = "keep_decoder"
+CONF_LOAD_ON = "load_on"
+CONF_LOADER = "loader"
+CONF_READ_AHEAD = "read_ahead"
+CONF_DECODE_THREADS = "decode_threads"
+CONF_READ_BUFFER_SIZE = "read_buffer_size"
+CONF_MAX_ACTIVE_LOADS = "max_active_loads"
+CONF_MEMORY_BUDGET = "memory_budget"
+CONF_TIME_SLICE = "time_slice"
+CONF_CACHE_SIZE = "cache_size"
+CONF_TRACE = "trace"
+CONF_WATCH_INTERVAL = "watch_interval"
+
+DOMAIN = "local_image"
+KEY_LOAD_SCHEDULER = "load_scheduler"
 
 # _LOGGER = logging.getLogger(__name__)
 
 local_image_ns = cg.esphome_ns.namespace("local_image")
+display_ns = cg.esphome_ns.namespace("display")
+Rect = display_ns.class_("Rect")
+Display = display_ns.class_("Display")
 ImageFormat = local_image_ns.enum("ImageFormat")
+StorageCompression = local_image_ns.enum("StorageCompression")
+FingerprintMode = local_image_ns.enum("FingerprintMode")
+PixelPacking = local_image_ns.enum("PixelPacking")
+DitherMode = local_image_ns.enum("DitherMode")
+LoadOn = local_image_ns.enum("LoadOn")
 LocalImage = local_image_ns.class_("LocalImage", cg.Component, Image_)
+LoadScheduler = local_image_ns.class_("LoadScheduler", cg.Component)
 
 
 class Format:
@@ -85,16 +134,79 @@ class PNGFormat(Format):
         cg.add_library("pngle", "1.0.2")
 
 
+class QOIFormat(Format):
+    def __init__(self):
+        super().__init__("QOI")
+
+    def actions(self):
+        cg.add_define("USE_LOCAL_IMAGE_QOI_SUPPORT")
+
+
 IMAGE_FORMATS = {
     x.image_type: x
     for x in (
         BMPFormat(),
         JPEGFormat(),
         PNGFormat(),
+        QOIFormat(),
     )
 }
 IMAGE_FORMATS.update({"JPG": IMAGE_FORMATS["JPEG"]})
 
+
+def _overlay_format(config):
+    if CONF_FORMAT not in config:
+        extension = config[CONF_PATH].rsplit(".", 1)[-1].upper()
+        if extension not in IMAGE_FORMATS:
+            raise cv.Invalid(
+                f"Can not tell the format of '{config[CONF_PATH]}', set '{CONF_FORMAT}'"
+            )
+        config[CONF_FORMAT] = extension
+    return config
+
+
+OVERLAY_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.Required(CONF_PATH): cv.string,
+            cv.Optional(CONF_X, default=0): cv.int_,
+            cv.Optional(CONF_Y, default=0): cv.int_,
+            cv.Optional(CONF_FORMAT): cv.one_of(*IMAGE_FORMATS, upper=True),
+        }
+    ),
+    _overlay_format,
+)
+
+COMPRESSION_TYPES = {
+    "NONE": StorageCompression.COMPRESSION_NONE,
+    "RLE": StorageCompression.COMPRESSION_RLE,
+}
+
+PACKING_TYPES = {
+    "NONE": PixelPacking.PACKING_NONE,
+    "GRAY2": PixelPacking.PACKING_GRAY2,
+    "GRAY4": PixelPacking.PACKING_GRAY4,
+    "RGB332": PixelPacking.PACKING_RGB332,
+}
+
+DITHER_MODES = {
+    "NONE": DitherMode.DITHER_NONE,
+    "ORDERED": DitherMode.DITHER_ORDERED,
+}
+
+LOAD_ON_MODES = {
+    "BOOT": LoadOn.LOAD_ON_BOOT,
+    "FIRST_DRAW": LoadOn.LOAD_ON_FIRST_DRAW,
+    "MANUAL": LoadOn.LOAD_ON_MANUAL,
+}
+
+FINGERPRINT_MODES = {
+    "NONE": FingerprintMode.FINGERPRINT_NONE,
+    "SIZE": FingerprintMode.FINGERPRINT_SIZE,
+    "HEAD": FingerprintMode.FINGERPRINT_HEAD,
+    "FULL": FingerprintMode.FINGERPRINT_FULL,
+}
+
 # Actions
 SetPathAction = local_image_ns.class_(
     "LocalImageSetPathAction", automation.Action, cg.Parented.template(LocalImage)
@@ -111,9 +223,21 @@ LocalImageLoadAction = local_image_ns.class_(
     "LocalImageLoadAction", automation.Action, cg.Parented.template(LocalImage)
 )
 
+LocalImageDrawDirectAction = local_image_ns.class_(
+    "LocalImageDrawDirectAction", automation.Action, cg.Parented.template(LocalImage)
+)
+LocalImageSetColorTransformAction = local_image_ns.class_(
+    "LocalImageSetColorTransformAction",
+    automation.Action,
+    cg.Parented.template(LocalImage),
+)
+
 # Triggers
 LoadFinishedTrigger = local_image_ns.class_(
-    "LoadFinishedTrigger", automation.Trigger.template()
+    "LoadFinishedTrigger", automation.Trigger.template(cg.std_vector.template(Rect))
+)
+LoadProgressTrigger = local_image_ns.class_(
+    "LoadProgressTrigger", automation.Trigger.template(Rect)
 )
 LoadErrorTrigger = local_image_ns.class_(
     "LoadErrorTrigger", automation.Trigger.template()
@@ -129,8 +253,28 @@ def remove_options(*options):
     }
 
 
+TRACE_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_BUFFER_SIZE, default=512): cv.int_range(min=16, max=65536),
+        cv.Optional(CONF_FILE, default="local_image_trace.json"): cv.string,
+        cv.Optional(CONF_LEVEL, default="LOAD"): cv.one_of("LOAD", "DRAW", upper=True),
+    }
+)
+
+LOADER_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_MAX_ACTIVE_LOADS, default=1): cv.int_range(min=1, max=8),
+        cv.Optional(CONF_MEMORY_BUDGET, default=0): cv.positive_int,
+        cv.Optional(CONF_CACHE_SIZE, default=0): cv.positive_int,
+        cv.Optional(
+            CONF_TIME_SLICE, default="20ms"
+        ): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_TRACE): TRACE_SCHEMA,
+    }
+)
+
 LOCAL_IMAGE_SCHEMA = IMAGE_SCHEMA.extend(
-    remove_options(CONF_FILE, CONF_INVERT_ALPHA, CONF_DITHER)
+    remove_options(CONF_FILE, CONF_INVERT_ALPHA)
 ).extend(
     {
         cv.Required(CONF_ID): cv.declare_id(LocalImage),
@@ -138,11 +282,47 @@ LOCAL_IMAGE_SCHEMA = IMAGE_SCHEMA.extend(
         cv.Required(CONF_IMAGE_PATH): cv.string,
         cv.Required(CONF_FORMAT): cv.one_of(*IMAGE_FORMATS, upper=True),
         cv.Optional(CONF_PLACEHOLDER): cv.use_id(Image_),
+        cv.Optional(CONF_COMPRESSION, default="NONE"): cv.enum(
+            COMPRESSION_TYPES, upper=True
+        ),
+        # Adds "mask" to the transparency modes of the image component.
+        cv.Optional(CONF_TRANSPARENCY, default="opaque"): cv.one_of(
+            "opaque", "chroma_key", "alpha_channel", CONF_MASK, lower=True
+        ),
+        cv.Optional(CONF_PACKING, default="NONE"): cv.enum(PACKING_TYPES, upper=True),
+        cv.Optional(CONF_DITHER, default="NONE"): cv.enum(DITHER_MODES, upper=True),
+        cv.Optional(CONF_ROTATION, default=0): cv.one_of(0, 90, 180, 270, int=True),
+        cv.Optional(CONF_MIRROR_X, default=False): cv.boolean,
+        cv.Optional(CONF_MIRROR_Y, default=False): cv.boolean,
+        cv.Optional(CONF_PRIORITY, default=0): cv.int_,
+        cv.Optional(CONF_STATISTICS, default=False): cv.boolean,
+        cv.Optional(CONF_FINGERPRINT, default="NONE"): cv.enum(
+            FINGERPRINT_MODES, upper=True
+        ),
+        cv.Optional(CONF_WATCH_INTERVAL): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_READ_BUFFER_SIZE, default=4096): cv.int_range(
+            min=512, max=262144
+        ),
+        cv.Optional(CONF_READ_AHEAD, default=False): cv.boolean,
+        cv.Optional(CONF_DECODE_THREADS, default=1): cv.int_range(min=1, max=8),
+        cv.Optional(CONF_KEEP_DECODER, default=True): cv.boolean,
+        cv.Optional(CONF_LOAD_ON, default="BOOT"): cv.enum(LOAD_ON_MODES, upper=True),
+        cv.Optional(CONF_OVERLAYS): cv.ensure_list(OVERLAY_SCHEMA),
+        cv.Optional(CONF_LOADER): LOADER_SCHEMA,
         cv.Optional(CONF_ON_LOAD_FINISHED): automation.validate_automation(
             {
                 cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(LoadFinishedTrigger),
             }
         ),
+        cv.Optional(CONF_PROGRESSIVE, default=False): cv.boolean,
+        cv.Optional(
+            CONF_PROGRESS_INTERVAL, default="200ms"
+        ): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_ON_PROGRESS): automation.validate_automation(
+            {
+                cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(LoadProgressTrigger),
+            }
+        ),
         cv.Optional(CONF_ON_ERROR): automation.validate_automation(
             {
                 cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(LoadErrorTrigger),
@@ -151,9 +331,70 @@ LOCAL_IMAGE_SCHEMA = IMAGE_SCHEMA.extend(
     }
 )
 
+
+def _validate_watch_interval(config):
+    if CONF_WATCH_INTERVAL in config and config[CONF_FINGERPRINT] == "NONE":
+        raise cv.Invalid(
+            f"'{CONF_WATCH_INTERVAL}' requires '{CONF_FINGERPRINT}' other than NONE"
+        )
+    return config
+
+
+def _validate_packing(config):
+    image_type = config[CONF_TYPE].upper()
+    packing = config[CONF_PACKING]
+    transparency = config[CONF_TRANSPARENCY].upper()
+    if packing in ("GRAY2", "GRAY4") and image_type != "GRAYSCALE":
+        raise cv.Invalid(f"'{CONF_PACKING}: {packing}' requires type GRAYSCALE")
+    if packing == "RGB332" and image_type not in ("RGB565", "RGB"):
+        raise cv.Invalid(f"'{CONF_PACKING}: {packing}' requires type RGB565 or RGB")
+    if packing != "NONE" and transparency != "OPAQUE":
+        raise cv.Invalid(f"'{CONF_PACKING}' is only supported for opaque images")
+    if transparency == "MASK" and image_type == "BINARY":
+        raise cv.Invalid(
+            f"'{CONF_TRANSPARENCY}: {CONF_MASK}' is not supported for type BINARY"
+        )
+    if config[CONF_DITHER] != "NONE":
+        if packing == "NONE" and image_type not in ("BINARY", "RGB565"):
+            raise cv.Invalid(
+                f"'{CONF_DITHER}' requires type BINARY, RGB565 or a '{CONF_PACKING}'"
+            )
+        if transparency == "CHROMA_KEY":
+            raise cv.Invalid(f"'{CONF_DITHER}' is not supported with chroma key")
+    return config
+
+
+def _validate_progressive(config):
+    if CONF_ON_PROGRESS in config and not config[CONF_PROGRESSIVE]:
+        raise cv.Invalid(f"'{CONF_ON_PROGRESS}' requires '{CONF_PROGRESSIVE}: true'")
+    return config
+
+
+def _validate_read_ahead(config):
+    if config[CONF_READ_AHEAD] and not (CORE.is_esp32 or CORE.is_host):
+        raise cv.Invalid(f"'{CONF_READ_AHEAD}' is only supported on esp32 and host")
+    return config
+
+
+def _validate_decode_threads(config):
+    if config[CONF_DECODE_THREADS] > 1:
+        if not (CORE.is_esp32 or CORE.is_host):
+            raise cv.Invalid(
+                f"'{CONF_DECODE_THREADS}' is only supported on esp32 and host"
+            )
+        if config[CONF_FORMAT] not in ("JPEG", "JPG"):
+            raise cv.Invalid(f"'{CONF_DECODE_THREADS}' is only supported for JPEG")
+    return config
+
+
 CONFIG_SCHEMA = cv.Schema(
     cv.All(
         LOCAL_IMAGE_SCHEMA,
+        _validate_read_ahead,
+        _validate_decode_threads,
+        _validate_packing,
+        _validate_progressive,
+        _validate_watch_interval,
         cv.require_framework_version(
             # esp8266 not supported yet; if enabled in the future, minimum version of 2.7.0 is needed
             # esp8266_arduino=cv.Version(2, 7, 0),
@@ -165,6 +406,17 @@ CONFIG_SCHEMA = cv.Schema(
     )
 )
 
+
+def _final_validate(config):
+    full_config = fv.full_config.get()
+    loaders = [conf for conf in full_config.get(DOMAIN, []) if CONF_LOADER in conf]
+    if len(loaders) > 1:
+        raise cv.Invalid(f"'{CONF_LOADER}' can be set on only one {DOMAIN}")
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
 SET_PATH_SCHEMA = cv.Schema(
     {
         cv.GenerateID(): cv.use_id(LocalImage),
@@ -212,12 +464,98 @@ async def sd_mmc_append_file_to_code(config, action_id, template_arg, args):
     return var
 
 
+DRAW_DIRECT_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.use_id(LocalImage),
+        cv.Required(CONF_DISPLAY_ID): cv.use_id(Display),
+        cv.Optional(CONF_X, default=0): cv.templatable(cv.int_),
+        cv.Optional(CONF_Y, default=0): cv.templatable(cv.int_),
+        cv.Optional(CONF_PATH): cv.templatable(cv.string),
+    }
+)
+
+
+@automation.register_action(
+    "local_image.draw_direct", LocalImageDrawDirectAction, DRAW_DIRECT_SCHEMA
+)
+async def local_image_draw_direct_to_code(config, action_id, template_arg, args):
+    parent = await cg.get_variable(config[CONF_ID])
+    var = cg.new_Pvariable(action_id, template_arg, parent)
+
+    display = await cg.get_variable(config[CONF_DISPLAY_ID])
+    cg.add(var.set_display(display))
+    x_ = await cg.templatable(config[CONF_X], args, cg.int_)
+    cg.add(var.set_x(x_))
+    y_ = await cg.templatable(config[CONF_Y], args, cg.int_)
+    cg.add(var.set_y(y_))
+    if CONF_PATH in config:
+        path_ = await cg.templatable(config[CONF_PATH], args, cg.std_string)
+        cg.add(var.set_path(path_))
+    return var
+
+
+COLOR_TRANSFORM_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.use_id(LocalImage),
+        cv.Optional(CONF_BRIGHTNESS): cv.templatable(cv.float_range(min=0.0, max=4.0)),
+        cv.Optional(CONF_CONTRAST): cv.templatable(cv.float_range(min=0.0, max=4.0)),
+        cv.Optional(CONF_TINT): cv.templatable(cv.use_id(ColorStruct)),
+        cv.Optional(CONF_INVERT): cv.templatable(cv.boolean),
+    }
+)
+
+
+@automation.register_action(
+    "local_image.set_color_transform",
+    LocalImageSetColorTransformAction,
+    COLOR_TRANSFORM_SCHEMA,
+)
+async def local_image_set_color_transform_to_code(
+    config, action_id, template_arg, args
+):
+    parent = await cg.get_variable(config[CONF_ID])
+    var = cg.new_Pvariable(action_id, template_arg, parent)
+
+    if CONF_BRIGHTNESS in config:
+        brightness_ = await cg.templatable(config[CONF_BRIGHTNESS], args, cg.float_)
+        cg.add(var.set_brightness(brightness_))
+    if CONF_CONTRAST in config:
+        contrast_ = await cg.templatable(config[CONF_CONTRAST], args, cg.float_)
+        cg.add(var.set_contrast(contrast_))
+    if CONF_TINT in config:
+        if cg.is_template(config[CONF_TINT]):
+            tint_ = await cg.templatable(config[CONF_TINT], args, ColorStruct)
+        else:
+            tint_ = await cg.get_variable(config[CONF_TINT])
+        cg.add(var.set_tint(tint_))
+    if CONF_INVERT in config:
+        invert_ = await cg.templatable(config[CONF_INVERT], args, cg.bool_)
+        cg.add(var.set_invert(invert_))
+    return var
+
+
+async def get_load_scheduler():
+    """Return the load scheduler shared by all local_image instances."""
+    data = CORE.data.setdefault(DOMAIN, {})
+    if KEY_LOAD_SCHEDULER not in data:
+        scheduler = cg.new_Pvariable(
+            ID("local_image_load_scheduler", is_declaration=True, type=LoadScheduler)
+        )
+        await cg.register_component(scheduler, {})
+        data[KEY_LOAD_SCHEDULER] = scheduler
+    return data[KEY_LOAD_SCHEDULER]
+
+
 async def to_code(config):
     image_format = IMAGE_FORMATS[config[CONF_FORMAT]]
     image_format.actions()
 
     width, height = config.get(CONF_RESIZE, (0, 0))
-    transparent = get_transparency_enum(config[CONF_TRANSPARENCY])
+    # With a mask the colors are stored as for an opaque image.
+    transparency = config[CONF_TRANSPARENCY]
+    transparent = get_transparency_enum(
+        "opaque" if transparency == CONF_MASK else transparency
+    )
 
     var = cg.new_Pvariable(
         config[CONF_ID],
@@ -239,13 +577,75 @@ async def to_code(config):
     # path = await cg.get_variable(config[CONF_IMAGE_PATH])
     cg.add(var.set_path(config[CONF_IMAGE_PATH]))
 
+    cg.add(var.set_compression(config[CONF_COMPRESSION]))
+    for overlay in config.get(CONF_OVERLAYS, []):
+        overlay_format = IMAGE_FORMATS[overlay[CONF_FORMAT]]
+        overlay_format.actions()
+        cg.add(
+            var.add_overlay(
+                overlay[CONF_PATH],
+                overlay[CONF_X],
+                overlay[CONF_Y],
+                overlay_format.enum,
+            )
+        )
+    cg.add(var.set_packing(config[CONF_PACKING]))
+    if transparency == CONF_MASK:
+        cg.add(var.set_transparency_mask(True))
+    cg.add(var.set_dither(config[CONF_DITHER]))
+    cg.add(var.set_rotation(config[CONF_ROTATION]))
+    cg.add(var.set_mirror_x(config[CONF_MIRROR_X]))
+    cg.add(var.set_mirror_y(config[CONF_MIRROR_Y]))
+    cg.add(var.set_priority(config[CONF_PRIORITY]))
+    cg.add(var.set_fingerprint_mode(config[CONF_FINGERPRINT]))
+    if config[CONF_STATISTICS]:
+        cg.add(var.set_statistics(True))
+    if watch_interval := config.get(CONF_WATCH_INTERVAL):
+        cg.add(var.set_watch_interval(watch_interval.total_milliseconds))
+    cg.add(var.set_read_buffer_size(config[CONF_READ_BUFFER_SIZE]))
+    cg.add(var.set_keep_decoder(config[CONF_KEEP_DECODER]))
+    cg.add(var.set_load_on(config[CONF_LOAD_ON]))
+    if config[CONF_READ_AHEAD]:
+        cg.add_define("USE_LOCAL_IMAGE_READ_AHEAD")
+        cg.add(var.set_read_ahead(True))
+    if config[CONF_DECODE_THREADS] > 1:
+        cg.add_define("USE_LOCAL_IMAGE_PARALLEL_DECODE")
+        cg.add(var.set_decode_threads(config[CONF_DECODE_THREADS]))
+
+    scheduler = await get_load_scheduler()
+    cg.add(var.set_scheduler(scheduler))
+    if loader := config.get(CONF_LOADER):
+        cg.add(scheduler.set_max_active_loads(loader[CONF_MAX_ACTIVE_LOADS]))
+        cg.add(scheduler.set_memory_budget(loader[CONF_MEMORY_BUDGET]))
+        cg.add(
+            scheduler.set_time_slice(loader[CONF_TIME_SLICE].total_milliseconds)
+        )
+        if loader[CONF_CACHE_SIZE] > 0:
+            cg.add_define("USE_LOCAL_IMAGE_FILE_CACHE")
+            cg.add(local_image_ns.global_file_cache.set_budget(loader[CONF_CACHE_SIZE]))
+        if trace := loader.get(CONF_TRACE):
+            cg.add_define("USE_LOCAL_IMAGE_TRACE")
+            if trace[CONF_LEVEL] == "DRAW":
+                cg.add_define("USE_LOCAL_IMAGE_TRACE_DRAW")
+            trace_buffer = local_image_ns.global_trace_buffer
+            cg.add(trace_buffer.set_capacity(trace[CONF_BUFFER_SIZE]))
+            cg.add(trace_buffer.set_file(trace[CONF_FILE]))
+
     if placeholder_id := config.get(CONF_PLACEHOLDER):
         placeholder = await cg.get_variable(placeholder_id)
         cg.add(var.set_placeholder(placeholder))
 
     for conf in config.get(CONF_ON_LOAD_FINISHED, []):
         trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
-        await automation.build_automation(trigger, [], conf)
+        await automation.build_automation(
+            trigger, [(cg.std_vector.template(Rect), "regions")], conf
+        )
+
+    cg.add(var.set_progressive(config[CONF_PROGRESSIVE]))
+    cg.add(var.set_progress_interval(config[CONF_PROGRESS_INTERVAL].total_milliseconds))
+    for conf in config.get(CONF_ON_PROGRESS, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [(Rect, "area")], conf)
 
     for conf in config.get(CONF_ON_ERROR, []):
         trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
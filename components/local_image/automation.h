@@ -33,10 +33,7 @@ template<typename... Ts> class LocalImageReloadAction : public Action<Ts...> {
  public:
   LocalImageReloadAction(LocalImage *parent) : parent_(parent) {}
   TEMPLATABLE_VALUE(std::string, path)
-  void play(Ts... x) override {
-    this->parent_->set_path(this->path_.value(x...));
-    this->parent_->load_image();
-  }
+  void play(Ts... x) override { this->parent_->request_load(this->path_.value(x...)); }
 
  protected:
   LocalImage *parent_;
@@ -50,7 +47,7 @@ template<typename... Ts> class LocalImageReloadAction : public Action<Ts...> {
 template<typename... Ts> class LocalImageReleaseAction : public Action<Ts...> {
  public:
   LocalImageReleaseAction(LocalImage *parent) : parent_(parent) {}
-  void play(Ts... x) override { this->parent_->free_image_buffer_(); }
+  void play(Ts... x) override { this->parent_->release(); }
 
  protected:
   LocalImage *parent_;
@@ -64,16 +61,83 @@ template<typename... Ts> class LocalImageReleaseAction : public Action<Ts...> {
 template<typename... Ts> class LocalImageLoadAction : public Action<Ts...> {
  public:
   LocalImageLoadAction(LocalImage *parent) : parent_(parent) {}
-  void play(Ts... x) override { this->parent_->load_image(); }
+  void play(Ts... x) override { this->parent_->request_load(this->parent_->get_path()); }
+
+ protected:
+  LocalImage *parent_;
+};
+
+/*
+     Decode an image straight to a display
+     local_image.draw_direct:
+         id:
+         display_id:
+         x:
+         y:
+         path:
+*/
+template<typename... Ts> class LocalImageDrawDirectAction : public Action<Ts...> {
+ public:
+  LocalImageDrawDirectAction(LocalImage *parent) : parent_(parent) {}
+  TEMPLATABLE_VALUE(std::string, path)
+  TEMPLATABLE_VALUE(int, x)
+  TEMPLATABLE_VALUE(int, y)
+  void set_display(display::Display *display) { this->display_ = display; }
+  void play(Ts... x) override {
+    std::string path = this->path_.has_value() ? this->path_.value(x...) : this->parent_->get_path();
+    this->parent_->draw_direct(this->display_, this->x_.value(x...), this->y_.value(x...), path);
+  }
 
  protected:
   LocalImage *parent_;
+  display::Display *display_{nullptr};
 };
 
-class LoadFinishedTrigger : public Trigger<> {
+/*
+     Adjust the colors of the image when it is drawn
+     local_image.set_color_transform:
+         id:
+         brightness:
+         contrast:
+         tint:
+         invert:
+*/
+template<typename... Ts> class LocalImageSetColorTransformAction : public Action<Ts...> {
+ public:
+  LocalImageSetColorTransformAction(LocalImage *parent) : parent_(parent) {}
+  TEMPLATABLE_VALUE(float, brightness)
+  TEMPLATABLE_VALUE(float, contrast)
+  TEMPLATABLE_VALUE(Color, tint)
+  TEMPLATABLE_VALUE(bool, invert)
+  void play(Ts... x) override {
+    // Options not given keep their current value.
+    ColorTransform transform = this->parent_->get_color_transform();
+    if (this->brightness_.has_value())
+      transform.brightness = this->brightness_.value(x...);
+    if (this->contrast_.has_value())
+      transform.contrast = this->contrast_.value(x...);
+    if (this->tint_.has_value())
+      transform.tint = this->tint_.value(x...);
+    if (this->invert_.has_value())
+      transform.invert = this->invert_.value(x...);
+    this->parent_->set_color_transform(transform);
+  }
+
+ protected:
+  LocalImage *parent_;
+};
+
+class LoadFinishedTrigger : public Trigger<std::vector<display::Rect>> {
  public:
   explicit LoadFinishedTrigger(LocalImage *parent) {
-    parent->add_on_finished_callback([this]() { this->trigger(); });
+    parent->add_on_finished_callback([this](const std::vector<display::Rect> &regions) { this->trigger(regions); });
+  }
+};
+
+class LoadProgressTrigger : public Trigger<display::Rect> {
+ public:
+  explicit LoadProgressTrigger(LocalImage *parent) {
+    parent->add_on_progress_callback([this](display::Rect area) { this->trigger(area); });
   }
 };
 
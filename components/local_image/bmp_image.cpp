@@ -5,6 +5,7 @@
 #include "esphome/components/display/display.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
+#include "trace.h"
 
 namespace esphome
 {
@@ -13,8 +14,23 @@ namespace esphome
 
         static const char *const TAG = "online_image.bmp";
 
+        void BmpDecoder::reset()
+        {
+            ImageDecoder::reset();
+            this->current_index_ = 0;
+            this->width_ = 0;
+            this->height_ = 0;
+            this->bits_per_pixel_ = 0;
+            this->compression_method_ = 0;
+            this->image_data_size_ = 0;
+            this->color_table_entries_ = 0;
+            this->width_bytes_ = 0;
+            this->data_offset_ = 0;
+        }
+
         int HOT BmpDecoder::decode(uint8_t *buffer, size_t size)
         {
+            LOCAL_IMAGE_TRACE_SCOPE("bmp decode");
             size_t index = 0;
             if (this->current_index_ == 0 && index == 0 && size > 14)
             {
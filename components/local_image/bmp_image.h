@@ -20,6 +20,7 @@ class BmpDecoder : public ImageDecoder {
    */
   BmpDecoder(LocalImage *image) : ImageDecoder(image) {}
 
+  void reset() override;
   int HOT decode(uint8_t *buffer, size_t size) override;
 
  protected:
@@ -0,0 +1,129 @@
+#include "file_cache.h"
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+
+#include "esphome/core/log.h"
+
+static const char *const TAG = "local_image.cache";
+
+namespace esphome {
+namespace local_image {
+
+FileCache global_file_cache;  // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+const uint8_t *FileCache::acquire(const std::string &path, size_t size) {
+  for (auto &entry : this->entries_) {
+    if (entry.complete && !entry.stale && entry.size == size && entry.path == path) {
+      entry.pins++;
+      entry.last_use = ++this->use_counter_;
+      this->hits_++;
+      ESP_LOGV(TAG, "Hit %s (%zu bytes)", path.c_str(), size);
+      return entry.data;
+    }
+  }
+  this->misses_++;
+  return nullptr;
+}
+
+uint8_t *FileCache::reserve(const std::string &path, size_t size) {
+  if (size == 0 || size > this->budget_) {
+    return nullptr;
+  }
+  // An older version of the file is not wanted anymore.
+  for (size_t i = 0; i < this->entries_.size(); i++) {
+    if (this->entries_[i].path == path && this->entries_[i].pins == 0) {
+      this->erase_(i);
+      break;
+    }
+  }
+  if (!this->make_room_(size)) {
+    ESP_LOGV(TAG, "No room for %s (%zu bytes)", path.c_str(), size);
+    return nullptr;
+  }
+  uint8_t *data = this->allocator_.allocate(size);
+  if (data == nullptr) {
+    ESP_LOGW(TAG, "Allocation of %zu bytes for %s failed", size, path.c_str());
+    return nullptr;
+  }
+  this->entries_.push_back(Entry{path, size, data, ++this->use_counter_, 1, false, false});
+  this->used_ += size;
+  return data;
+}
+
+void FileCache::release(const uint8_t *data, bool complete) {
+  for (size_t i = 0; i < this->entries_.size(); i++) {
+    Entry &entry = this->entries_[i];
+    if (entry.data != data) {
+      continue;
+    }
+    if (entry.pins > 0) {
+      entry.pins--;
+    }
+    if (entry.stale) {
+      if (entry.pins == 0) {
+        this->erase_(i);
+      }
+    } else if (!entry.complete) {
+      if (complete) {
+        entry.complete = true;
+        ESP_LOGD(TAG, "Cached %s (%zu bytes), %zu of %zu bytes used", entry.path.c_str(), entry.size, this->used_,
+                 this->budget_);
+      } else {
+        this->erase_(i);
+      }
+    }
+    return;
+  }
+}
+
+void FileCache::forget(const std::string &path) {
+  for (size_t i = this->entries_.size(); i > 0; i--) {
+    Entry &entry = this->entries_[i - 1];
+    if (entry.path != path) {
+      continue;
+    }
+    ESP_LOGV(TAG, "Forget %s", path.c_str());
+    if (entry.pins == 0) {
+      this->erase_(i - 1);
+    } else {
+      entry.stale = true;
+    }
+  }
+}
+
+void FileCache::clear() {
+  for (size_t i = this->entries_.size(); i > 0; i--) {
+    if (this->entries_[i - 1].pins == 0) {
+      this->erase_(i - 1);
+    }
+  }
+}
+
+bool FileCache::make_room_(size_t size) {
+  while (this->used_ + size > this->budget_) {
+    size_t oldest = this->entries_.size();
+    for (size_t i = 0; i < this->entries_.size(); i++) {
+      if (this->entries_[i].pins == 0 &&
+          (oldest == this->entries_.size() || this->entries_[i].last_use < this->entries_[oldest].last_use)) {
+        oldest = i;
+      }
+    }
+    if (oldest == this->entries_.size()) {
+      return false;
+    }
+    ESP_LOGV(TAG, "Evict %s", this->entries_[oldest].path.c_str());
+    this->erase_(oldest);
+  }
+  return true;
+}
+
+void FileCache::erase_(size_t index) {
+  Entry &entry = this->entries_[index];
+  this->allocator_.deallocate(entry.data, entry.size);
+  this->used_ -= entry.size;
+  this->entries_.erase(this->entries_.begin() + index);
+}
+
+}  // namespace local_image
+}  // namespace esphome
+
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+namespace local_image {
+
+/**
+ * @brief Least recently used cache of whole image files, shared by all images.
+ *
+ * Files are kept as read from storage, so loading an image again only costs the decode.
+ * Entries are keyed by path and size, and the files together stay within a byte budget.
+ * A file changed on storage without changing size is dropped with forget().
+ * Entries in use by a running load are pinned and never evicted.
+ */
+class FileCache {
+ public:
+  void set_budget(size_t budget) { this->budget_ = budget; }
+  size_t get_budget() const { return this->budget_; }
+
+  /**
+   * @brief Look up a file. On a hit the data stays valid until release().
+   *
+   * @return The file contents, nullptr on a miss.
+   */
+  const uint8_t *acquire(const std::string &path, size_t size);
+
+  /**
+   * @brief Make room for a file about to be read, evicting the least recently used files.
+   * The caller fills the buffer and passes it to release().
+   *
+   * @return The buffer to fill, nullptr if the file does not fit.
+   */
+  uint8_t *reserve(const std::string &path, size_t size);
+
+  /**
+   * @brief Give back a file returned by acquire() or reserve().
+   *
+   * @param complete A reserved buffer was filled with the whole file; otherwise it is dropped.
+   */
+  void release(const uint8_t *data, bool complete);
+
+  /**
+   * @brief Drop a file that changed on storage. Entries still in use are dropped on their last release().
+   */
+  void forget(const std::string &path);
+
+  /** Drop all files not in use. */
+  void clear();
+
+  uint32_t get_hits() const { return this->hits_; }
+  uint32_t get_misses() const { return this->misses_; }
+  /** Bytes held by cached files. */
+  size_t get_used() const { return this->used_; }
+  size_t get_count() const { return this->entries_.size(); }
+
+ protected:
+  struct Entry {
+    std::string path;
+    size_t size;
+    uint8_t *data;
+    uint32_t last_use;
+    uint8_t pins;
+    bool complete;
+    bool stale;
+  };
+
+  /** Evict unpinned entries, least recently used first, until size more bytes fit. */
+  bool make_room_(size_t size);
+  void erase_(size_t index);
+
+  RAMAllocator<uint8_t> allocator_{};
+  std::vector<Entry> entries_;
+  size_t budget_{0};
+  size_t used_{0};
+  uint32_t use_counter_{0};
+  uint32_t hits_{0};
+  uint32_t misses_{0};
+};
+
+extern FileCache global_file_cache;  // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+}  // namespace local_image
+}  // namespace esphome
+
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
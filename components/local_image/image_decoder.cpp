@@ -2,6 +2,7 @@
 #include "local_image.h"
 
 #include "esphome/core/log.h"
+#include "trace.h"
 
 namespace esphome
 {
@@ -12,16 +13,45 @@ namespace esphome
 
         bool ImageDecoder::set_size(int width, int height)
         {
-            bool success = this->image_->resize_(width, height) > 0;
-            this->x_scale_ = static_cast<double>(this->image_->buffer_width_) / width;
-            this->y_scale_ = static_cast<double>(this->image_->buffer_height_) / height;
+            if (this->image_->overlay_index_ >= 0)
+            {
+                // Overlays are blended at their own size.
+                this->x_scale_ = 1.0;
+                this->y_scale_ = 1.0;
+                this->image_->overlay_width_ = width;
+                this->image_->overlay_height_ = height;
+                return true;
+            }
+            // The buffer is allocated in display orientation, decoders draw in image orientation.
+            bool success = this->image_->is_swapped_() ? this->image_->create_image_buffer(height, width) > 0
+                                                       : this->image_->create_image_buffer(width, height) > 0;
+            this->x_scale_ = static_cast<double>(this->image_->get_decode_width_()) / width;
+            this->y_scale_ = static_cast<double>(this->image_->get_decode_height_()) / height;
             return success;
         }
 
         void ImageDecoder::draw(int x, int y, int w, int h, const Color &color)
         {
-            auto width = std::min(this->image_->buffer_width_, static_cast<int>(std::ceil((x + w) * this->x_scale_)));
-            auto height = std::min(this->image_->buffer_height_, static_cast<int>(std::ceil((y + h) * this->y_scale_)));
+            LOCAL_IMAGE_TRACE_DRAW_SCOPE("draw");
+            if (this->image_->overlay_index_ >= 0)
+            {
+                this->image_->draw_overlay_(x, y, w, h, color);
+                return;
+            }
+            if (this->image_->is_direct_())
+            {
+                // Decoders finish a band before starting the next one, so only complete rows are sent to the display.
+                const int unit = LocalImage::DIRECT_BAND_ROWS;
+                const int band = y / unit;
+                if (band != this->image_->band_index_)
+                {
+                    this->image_->select_band_(band, static_cast<int>(band * unit * this->y_scale_),
+                                               std::min(this->image_->get_decode_height_(),
+                                                        static_cast<int>(std::ceil((band + 1) * unit * this->y_scale_))));
+                }
+            }
+            auto width = std::min(this->image_->get_decode_width_(), static_cast<int>(std::ceil((x + w) * this->x_scale_)));
+            auto height = std::min(this->image_->get_decode_height_(), static_cast<int>(std::ceil((y + h) * this->y_scale_)));
             for (int i = x * this->x_scale_; i < width; i++)
             {
                 for (int j = y * this->y_scale_; j < height; j++)
@@ -30,5 +60,18 @@ namespace esphome
                 }
             }
         }
+
+        void ImageDecoder::draw_rows(int x, int y, int w, int h, const Color &color, int row_begin, int row_end)
+        {
+            auto width = std::min(this->image_->get_decode_width_(), static_cast<int>(std::ceil((x + w) * this->x_scale_)));
+            auto height = std::min(row_end, static_cast<int>(std::ceil((y + h) * this->y_scale_)));
+            for (int i = x * this->x_scale_; i < width; i++)
+            {
+                for (int j = std::max(row_begin, static_cast<int>(y * this->y_scale_)); j < height; j++)
+                {
+                    this->image_->draw_pixel_(i, j, color);
+                }
+            }
+        }
     } // namespace online_image
 } // namespace esphome
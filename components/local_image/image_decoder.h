@@ -41,6 +41,18 @@ namespace esphome
                 return 0;
             }
 
+            /**
+             * @brief Forget the previous image, so that the decoder can be used for a new one.
+             * Memory allocated by the decoder is kept for the next image.
+             */
+            virtual void reset()
+            {
+                this->download_size_ = 1;
+                this->decoded_bytes_ = 0;
+                this->x_scale_ = 1.0;
+                this->y_scale_ = 1.0;
+            }
+
             /**
              * @brief Decode a part of the image. It will try reading from the buffer.
              * There is no guarantee that the whole available buffer will be read/decoded;
@@ -78,6 +90,12 @@ namespace esphome
              */
             void draw(int x, int y, int w, int h, const Color &color);
 
+            /**
+             * @brief Like draw(), but only the image rows from row_begin up to row_end (exclusive,
+             * after scaling) are drawn. Used by workers drawing separate bands of the image at the same time.
+             */
+            void draw_rows(int x, int y, int w, int h, const Color &color, int row_begin, int row_end);
+
             bool is_finished() const { return this->decoded_bytes_ == this->download_size_; }
 
         protected:
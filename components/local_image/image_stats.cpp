@@ -0,0 +1,89 @@
+#include "image_stats.h"
+
+#include <algorithm>
+
+namespace esphome {
+namespace local_image {
+
+void ImageStats::reset() {
+  this->count_ = 0;
+  this->sum_r_ = 0;
+  this->sum_g_ = 0;
+  this->sum_b_ = 0;
+  this->x1_ = INT16_MAX;
+  this->y1_ = INT16_MAX;
+  this->x2_ = -1;
+  this->y2_ = -1;
+  this->histogram_.fill(0);
+  this->buckets_.fill(0);
+}
+
+void ImageStats::merge(const ImageStats &other) {
+  this->count_ += other.count_;
+  this->sum_r_ += other.sum_r_;
+  this->sum_g_ += other.sum_g_;
+  this->sum_b_ += other.sum_b_;
+  this->x1_ = std::min(this->x1_, other.x1_);
+  this->y1_ = std::min(this->y1_, other.y1_);
+  this->x2_ = std::max(this->x2_, other.x2_);
+  this->y2_ = std::max(this->y2_, other.y2_);
+  for (int i = 0; i < HISTOGRAM_BINS; i++)
+    this->histogram_[i] += other.histogram_[i];
+  for (int i = 0; i < BUCKETS; i++)
+    this->buckets_[i] += other.buckets_[i];
+}
+
+Color ImageStats::get_average_color() const {
+  if (this->count_ == 0)
+    return Color(0, 0, 0);
+  return Color(this->sum_r_ / this->count_, this->sum_g_ / this->count_, this->sum_b_ / this->count_);
+}
+
+uint8_t ImageStats::get_average_luminance() const {
+  Color average = this->get_average_color();
+  return (average.r * 54 + average.g * 183 + average.b * 19) >> 8;
+}
+
+uint8_t ImageStats::get_luminance_percentile(float fraction) const {
+  const uint64_t target = static_cast<uint64_t>(std::max(0.0f, std::min(1.0f, fraction)) * this->count_);
+  uint64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_BINS; i++) {
+    seen += this->histogram_[i];
+    if (seen >= target && seen > 0)
+      return ((i + 1) << HISTOGRAM_SHIFT) - 1;
+  }
+  return 255;
+}
+
+std::vector<DominantColor> ImageStats::get_dominant_colors(size_t count) const {
+  std::vector<DominantColor> colors;
+  if (this->count_ == 0)
+    return colors;
+  std::vector<uint16_t> order;
+  for (int i = 0; i < BUCKETS; i++) {
+    if (this->buckets_[i] != 0)
+      order.push_back(i);
+  }
+  count = std::min(count, order.size());
+  std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                    [this](uint16_t a, uint16_t b) { return this->buckets_[a] > this->buckets_[b]; });
+  const int mask = (1 << BUCKET_BITS) - 1;
+  const int shift = 8 - BUCKET_BITS;
+  const int half = 1 << (shift - 1);
+  for (size_t i = 0; i < count; i++) {
+    const int bucket = order[i];
+    Color center(((bucket >> (2 * BUCKET_BITS)) << shift) + half, (((bucket >> BUCKET_BITS) & mask) << shift) + half,
+                 ((bucket & mask) << shift) + half);
+    colors.push_back(DominantColor{center, static_cast<float>(this->buckets_[bucket]) / this->count_});
+  }
+  return colors;
+}
+
+display::Rect ImageStats::get_opaque_area() const {
+  if (this->x2_ < this->x1_)
+    return display::Rect();
+  return display::Rect(this->x1_, this->y1_, this->x2_ - this->x1_ + 1, this->y2_ - this->y1_ + 1);
+}
+
+}  // namespace local_image
+}  // namespace esphome
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cinttypes>
+#include <vector>
+
+#include "esphome/core/color.h"
+#include "esphome/core/helpers.h"
+#include "esphome/components/display/rect.h"
+
+namespace esphome {
+namespace local_image {
+
+/**
+ * @brief A color which covers a part of the image.
+ */
+struct DominantColor {
+  /** Center of the color bucket. */
+  Color color;
+  /** Fraction of the opaque pixels in the bucket, 0 to 1. */
+  float share;
+};
+
+/**
+ * @brief Statistics of the opaque pixels of an image, collected while the pixels are written.
+ */
+class ImageStats {
+ public:
+  /** Luminance levels per histogram bin. */
+  static const int HISTOGRAM_SHIFT = 2;
+  static const int HISTOGRAM_BINS = 256 >> HISTOGRAM_SHIFT;
+  /** Bits per channel of the color buckets. */
+  static const int BUCKET_BITS = 3;
+  static const int BUCKETS = 1 << (3 * BUCKET_BITS);
+
+  void reset();
+
+  /** Count a pixel, at buffer coordinates. Pixels with an alpha value below 0x80 are left out. */
+  ESPHOME_ALWAYS_INLINE void add(int x, int y, Color color) {
+    if (color.w < 0x80)
+      return;
+    this->count_++;
+    this->sum_r_ += color.r;
+    this->sum_g_ += color.g;
+    this->sum_b_ += color.b;
+    // Same weights as the conversion to grayscale, in 8 bit fixed point.
+    const uint8_t luminance = (color.r * 54 + color.g * 183 + color.b * 19) >> 8;
+    this->histogram_[luminance >> HISTOGRAM_SHIFT]++;
+    const int shift = 8 - BUCKET_BITS;
+    this->buckets_[((color.r >> shift) << (2 * BUCKET_BITS)) | ((color.g >> shift) << BUCKET_BITS) |
+                   (color.b >> shift)]++;
+    if (x < this->x1_)
+      this->x1_ = x;
+    if (x > this->x2_)
+      this->x2_ = x;
+    if (y < this->y1_)
+      this->y1_ = y;
+    if (y > this->y2_)
+      this->y2_ = y;
+  }
+
+  /** Add the pixels counted by another instance, e.g. of a band decoded on another thread. */
+  void merge(const ImageStats &other);
+
+  /** Number of opaque pixels. */
+  uint32_t get_pixel_count() const { return this->count_; }
+  /** Average color of the opaque pixels, black if there are none. */
+  Color get_average_color() const;
+  /** Average luminance of the opaque pixels, 0 to 255. */
+  uint8_t get_average_luminance() const;
+  /** Luminance below which the given fraction (0 to 1) of the opaque pixels lie, at the resolution of the histogram. */
+  uint8_t get_luminance_percentile(float fraction) const;
+  /** Opaque pixels per luminance range of 256 / HISTOGRAM_BINS levels. */
+  const std::array<uint32_t, HISTOGRAM_BINS> &get_luminance_histogram() const { return this->histogram_; }
+  /** The most frequent colors, from 512 buckets, most frequent first. */
+  std::vector<DominantColor> get_dominant_colors(size_t count) const;
+  /** Bounding box of the opaque pixels, not set if there are none. */
+  display::Rect get_opaque_area() const;
+
+ protected:
+  uint32_t count_{0};
+  uint64_t sum_r_{0};
+  uint64_t sum_g_{0};
+  uint64_t sum_b_{0};
+  int x1_{INT16_MAX};
+  int y1_{INT16_MAX};
+  int x2_{-1};
+  int y2_{-1};
+  std::array<uint32_t, HISTOGRAM_BINS> histogram_{};
+  std::array<uint32_t, BUCKETS> buckets_{};
+};
+
+}  // namespace local_image
+}  // namespace esphome
@@ -7,6 +7,18 @@
 #include "esphome/core/log.h"
 
 #include "local_image.h"
+#include "trace.h"
+
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+#ifdef USE_ESP32
+#include <esp_pthread.h>
+#endif
+#endif  // USE_LOCAL_IMAGE_PARALLEL_DECODE
 static const char *const TAG = "local_image.jpeg";
 
 namespace esphome {
@@ -19,6 +31,7 @@ namespace local_image {
  * @param jpeg  The JPEGDRAW object, including the context data.
  */
 static int draw_callback(JPEGDRAW *jpeg) {
+  LOCAL_IMAGE_TRACE_SCOPE("jpeg draw");
   ImageDecoder *decoder = (ImageDecoder *) jpeg->pUser;
 
   // Some very big images take too long to decode, so feed the watchdog on each callback
@@ -41,17 +54,365 @@ static int draw_callback(JPEGDRAW *jpeg) {
   return 1;
 }
 
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+static int band_draw_callback(JPEGDRAW *jpeg) {
+  LOCAL_IMAGE_TRACE_SCOPE("jpeg band draw");
+  JpegBand *band = (JpegBand *) jpeg->pUser;
+  if (band->jpeg == nullptr) {
+    // Only the loop thread may feed the watchdog.
+    App.feed_wdt();
+  }
+  return band->decoder->draw_band(*band, jpeg) ? 1 : 0;
+}
+
+/** Layout of a baseline JPEG file with restart markers, see parse_restart_layout(). */
+struct RestartLayout {
+  /** SOI and the segments needed to decode (DQT, DHT, DRI, SOF and SOS), without APPn and COM. */
+  std::vector<uint8_t> header;
+  /** Offset of the image height in the SOF segment of the header. */
+  size_t height_pos{0};
+  int width{0};
+  int height{0};
+  int components{0};
+  int mcu_width{8};
+  int mcu_height{8};
+  /** MCUs per restart interval. */
+  int interval{0};
+  /** Entropy coded data, from after SOS up to EOI. */
+  size_t data_begin{0};
+  size_t data_end{0};
+  /** Offset of each RSTn marker, the end of one restart interval. */
+  std::vector<size_t> restarts;
+};
+
+static bool parse_restart_layout(const uint8_t *data, size_t size, RestartLayout &layout) {
+  if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+  layout.header.assign(data, data + 2);
+  size_t pos = 2;
+  while (pos + 4 <= size) {
+    if (data[pos] != 0xFF) {
+      return false;
+    }
+    const uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) {
+      // Fill byte.
+      pos++;
+      continue;
+    }
+    const uint8_t *segment = data + pos;
+    const size_t length = (segment[2] << 8) | segment[3];
+    if (pos + 2 + length > size) {
+      return false;
+    }
+    if (marker == 0xC0 || marker == 0xC1) {
+      if (length < 8) {
+        return false;
+      }
+      layout.height_pos = layout.header.size() + 5;
+      layout.height = (segment[5] << 8) | segment[6];
+      layout.width = (segment[7] << 8) | segment[8];
+      layout.components = segment[9];
+      if (length < 8 + 3u * layout.components) {
+        return false;
+      }
+      if (layout.components > 1) {
+        // An interleaved MCU covers the largest sampling factors.
+        int h = 1, v = 1;
+        for (int i = 0; i < layout.components; i++) {
+          h = std::max(h, segment[11 + 3 * i] >> 4);
+          v = std::max(v, segment[11 + 3 * i] & 0x0F);
+        }
+        layout.mcu_width = 8 * h;
+        layout.mcu_height = 8 * v;
+      }
+    } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+      // Progressive, lossless or arithmetic coding.
+      return false;
+    } else if (marker == 0xDD && length >= 4) {
+      layout.interval = (segment[4] << 8) | segment[5];
+    }
+    if (marker == 0xDB || marker == 0xC4 || marker == 0xDD || marker == 0xC0 || marker == 0xC1 || marker == 0xDA) {
+      layout.header.insert(layout.header.end(), segment, segment + 2 + length);
+    }
+    pos += 2 + length;
+    if (marker == 0xDA) {
+      // Only a single interleaved scan can be split.
+      if (layout.height_pos == 0 || layout.interval == 0 || segment[4] != layout.components) {
+        return false;
+      }
+      layout.data_begin = pos;
+      break;
+    }
+  }
+  if (layout.data_begin == 0) {
+    return false;
+  }
+
+  layout.data_end = size;
+  for (size_t i = layout.data_begin; i + 1 < size; i++) {
+    const uint8_t *next = static_cast<const uint8_t *>(memchr(data + i, 0xFF, size - 1 - i));
+    if (next == nullptr) {
+      break;
+    }
+    i = next - data;
+    const uint8_t marker = data[i + 1];
+    if (marker >= 0xD0 && marker <= 0xD7) {
+      layout.restarts.push_back(i);
+      i++;
+    } else if (marker != 0x00 && marker != 0xFF) {
+      layout.data_end = i;
+      break;
+    }
+  }
+  // The markers must match the intervals, or the file is not what it claims.
+  const size_t mcus = static_cast<size_t>((layout.width + layout.mcu_width - 1) / layout.mcu_width) *
+                      ((layout.height + layout.mcu_height - 1) / layout.mcu_height);
+  return !layout.restarts.empty() && layout.restarts.size() + 1 == (mcus + layout.interval - 1) / layout.interval;
+}
+
+bool JpegDecoder::draw_band(JpegBand &band, JPEGDRAW *jpeg) {
+  const int top = jpeg->y + band.y_offset;
+  if (static_cast<int>(top * this->y_scale_) >= band.row_end) {
+    band.stopped = true;
+    return false;
+  }
+  if ((top + jpeg->iHeight) * this->y_scale_ <= band.row_begin) {
+    // Decoded only to get to the band, nothing to draw.
+    return true;
+  }
+  size_t position = 0;
+  for (int y = 0; y < jpeg->iHeight; y++) {
+    for (int x = 0; x < jpeg->iWidth; x++) {
+      auto rg = decode_value(jpeg->pPixels[position++]);
+      auto ba = decode_value(jpeg->pPixels[position++]);
+      Color color(rg[1], rg[0], ba[1], ba[0]);
+      this->draw_rows(jpeg->x + x, top + y, 1, 1, color, band.row_begin, band.row_end);
+    }
+  }
+  return true;
+}
+
+void JpegDecoder::decode_band_(JpegBand &band, int options) {
+  JPEGDEC *jpeg = band.jpeg != nullptr ? band.jpeg : &this->jpeg_;
+  if (!jpeg->openRAM(band.data, band.size, band_draw_callback)) {
+    band.ok = false;
+    return;
+  }
+  jpeg->setUserPointer(&band);
+  jpeg->setPixelType(RGB8888);
+  // A band with more data than its rows ends the decode from its callback.
+  band.ok = jpeg->decode(0, 0, options) || band.stopped;
+  jpeg->close();
+}
+
+bool JpegDecoder::plan_bands_(uint8_t *buffer, size_t size, int threads, std::vector<JpegBand> &bands) {
+  RestartLayout layout;
+  if (!parse_restart_layout(buffer, size, layout)) {
+    return false;
+  }
+  const int mcus_per_row = (layout.width + layout.mcu_width - 1) / layout.mcu_width;
+  const int mcu_rows = (layout.height + layout.mcu_height - 1) / layout.mcu_height;
+  const int intervals = layout.restarts.size() + 1;
+  // A band can only start at an MCU row which starts a restart interval.
+  auto starts_interval = [&](int mcu_row) {
+    return mcu_row >= mcu_rows || static_cast<long>(mcu_row) * mcus_per_row % layout.interval == 0;
+  };
+  // MCU row holding an image row after scaling.
+  const double rows_per_mcu_row = this->y_scale_ * layout.mcu_height / this->scale_;
+
+  const int height = this->image_->get_decode_height_();
+  // Bands are a multiple of 16 rows, so that workers mark separate rows of dirty tiles.
+  const int rows = ((height + threads - 1) / threads + 15) / 16 * 16;
+  this->band_rows_ = rows;
+  // MCU rows from which each band is decoded.
+  std::vector<int> firsts;
+  for (int begin = 0; begin < height; begin += rows) {
+    int first = std::min(static_cast<int>(begin / rows_per_mcu_row), mcu_rows - 1);
+    while (!starts_interval(first)) {
+      first--;
+    }
+    if (!bands.empty() && first == firsts.back()) {
+      // Restart intervals too long to split here, the previous band takes these rows.
+      bands.back().row_end = std::min(height, begin + rows);
+      continue;
+    }
+    firsts.push_back(first);
+    bands.push_back(JpegBand{this, nullptr, begin, std::min(height, begin + rows), buffer, size,
+                             first * layout.mcu_height / this->scale_, false, false});
+  }
+  if (bands.size() < 2) {
+    bands.clear();
+    return false;
+  }
+
+  // The first band decodes the file itself and stops after its rows, the others get a copy of
+  // their restart intervals behind the header, with the image height and the RSTn numbers patched.
+  RAMAllocator<uint8_t> allocator;
+  for (size_t i = 1; i < bands.size(); i++) {
+    const int first = firsts[i];
+    int last = std::min(static_cast<int>(std::ceil(bands[i].row_end / rows_per_mcu_row)), mcu_rows);
+    while (!starts_interval(last)) {
+      last++;
+    }
+    const int interval_begin = static_cast<long>(first) * mcus_per_row / layout.interval;
+    const int interval_end = last >= mcu_rows ? intervals : static_cast<long>(last) * mcus_per_row / layout.interval;
+    const size_t begin = layout.restarts[interval_begin - 1] + 2;
+    const size_t end = interval_end == intervals ? layout.data_end : layout.restarts[interval_end - 1];
+    const size_t band_size = layout.header.size() + (end - begin) + 2;
+    uint8_t *data = allocator.allocate(band_size);
+    if (data == nullptr) {
+      ESP_LOGW(TAG, "No memory for band %zu (%zu bytes), decoding on one thread", i, band_size);
+      for (size_t j = 1; j < i; j++) {
+        allocator.deallocate(bands[j].data, bands[j].size);
+      }
+      bands.clear();
+      return false;
+    }
+    memcpy(data, layout.header.data(), layout.header.size());
+    const int band_height = std::min(layout.height - first * layout.mcu_height, (last - first) * layout.mcu_height);
+    data[layout.height_pos] = band_height >> 8;
+    data[layout.height_pos + 1] = band_height & 0xFF;
+    uint8_t *entropy = data + layout.header.size();
+    memcpy(entropy, buffer + begin, end - begin);
+    for (int k = interval_begin; k + 1 < interval_end; k++) {
+      entropy[layout.restarts[k] - begin + 1] = 0xD0 + ((k - interval_begin) & 7);
+    }
+    data[band_size - 2] = 0xFF;
+    data[band_size - 1] = 0xD9;
+    bands[i].data = data;
+    bands[i].size = band_size;
+  }
+  ESP_LOGV(TAG, "Split into %zu bands at restart markers (every %d MCUs)", bands.size(), layout.interval);
+  return true;
+}
+
+bool JpegDecoder::decode_parallel_(std::vector<JpegBand> &bands, uint8_t *buffer, int options) {
+  // The first band is decoded on the loop thread with jpeg_, the others each by a worker.
+  // Without memory for enough workers, the remaining bands are decoded on the loop thread too.
+  this->start_workers_(bands.size() - 1);
+  this->band_options_ = options;
+  // Merged bands cover several units of band_rows_, each still written by a single band.
+  const int height = this->image_->get_decode_height_();
+  this->image_->begin_parallel_decode_(this->band_rows_, (height + this->band_rows_ - 1) / this->band_rows_);
+  {
+    std::lock_guard<std::mutex> lock(this->workers_lock_);
+    for (size_t i = 1; i < bands.size() && i <= this->workers_.size(); i++) {
+      bands[i].jpeg = &this->workers_[i - 1]->jpeg;
+      this->workers_[i - 1]->band = &bands[i];
+    }
+  }
+  this->workers_cond_.notify_all();
+  for (auto &band : bands) {
+    if (band.jpeg == nullptr) {
+      this->decode_band_(band, options);
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(this->workers_lock_);
+    this->workers_cond_.wait(lock, [this] {
+      for (auto &worker : this->workers_) {
+        if (worker->band != nullptr)
+          return false;
+      }
+      return true;
+    });
+  }
+  this->image_->end_parallel_decode_();
+
+  RAMAllocator<uint8_t> allocator;
+  bool ok = true;
+  for (auto &band : bands) {
+    ok = ok && band.ok;
+    if (band.data != buffer) {
+      allocator.deallocate(band.data, band.size);
+    }
+  }
+  return ok;
+}
+
+void JpegDecoder::start_workers_(size_t count) {
+  if (this->workers_.size() >= count) {
+    return;
+  }
+#ifdef USE_ESP32
+  // Only the workers get this config, the loop task gets its previous one back afterwards.
+  esp_pthread_cfg_t previous;
+  if (esp_pthread_get_cfg(&previous) != ESP_OK) {
+    previous = esp_pthread_get_default_config();
+  }
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = 6144;
+  cfg.thread_name = "local_image_jpg";
+  // The main loop runs on core 1, keep the workers on the other core.
+  cfg.pin_to_core = 0;
+  esp_pthread_set_cfg(&cfg);
+#endif
+  while (this->workers_.size() < count) {
+    std::unique_ptr<JpegWorker> worker(new (std::nothrow) JpegWorker());
+    if (worker == nullptr) {
+      ESP_LOGW(TAG, "No memory for a decoder, %zu band(s) decoded on the loop thread", count - this->workers_.size());
+      break;
+    }
+    worker->thread = std::thread(&JpegDecoder::worker_loop_, this, worker.get());
+    this->workers_.push_back(std::move(worker));
+  }
+#ifdef USE_ESP32
+  esp_pthread_set_cfg(&previous);
+#endif
+}
+
+void JpegDecoder::worker_loop_(JpegWorker *worker) {
+  while (true) {
+    JpegBand *band;
+    {
+      std::unique_lock<std::mutex> lock(this->workers_lock_);
+      this->workers_cond_.wait(lock, [this, worker] { return this->stop_workers_ || worker->band != nullptr; });
+      if (this->stop_workers_) {
+        return;
+      }
+      band = worker->band;
+    }
+    this->decode_band_(*band, this->band_options_);
+    {
+      std::lock_guard<std::mutex> lock(this->workers_lock_);
+      worker->band = nullptr;
+    }
+    this->workers_cond_.notify_all();
+  }
+}
+#endif  // USE_LOCAL_IMAGE_PARALLEL_DECODE
+
+JpegDecoder::~JpegDecoder() {
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+  {
+    std::lock_guard<std::mutex> lock(this->workers_lock_);
+    this->stop_workers_ = true;
+  }
+  this->workers_cond_.notify_all();
+  for (auto &worker : this->workers_) {
+    worker->thread.join();
+  }
+#endif  // USE_LOCAL_IMAGE_PARALLEL_DECODE
+}
+
 int JpegDecoder::prepare(size_t download_size) {
   ImageDecoder::prepare(download_size);
-  // auto size = this->image_->resize_download_buffer(download_size);
-  // if (size < download_size) {
-  //   ESP_LOGE(TAG, "Download buffer resize failed!");
-  //   return DECODE_ERROR_OUT_OF_MEMORY;
-  // }
+  // JPEGDEC decodes from memory, so the whole file has to be read first. A cached file is decoded in place.
+  if (this->image_->is_cached_()) {
+    return 0;
+  }
+  auto size = this->image_->resize_source_buffer(download_size);
+  if (size < download_size) {
+    ESP_LOGE(TAG, "Source buffer resize failed!");
+    return DECODE_ERROR_OUT_OF_MEMORY;
+  }
   return 0;
 }
 
 int HOT JpegDecoder::decode(uint8_t *buffer, size_t size) {
+  LOCAL_IMAGE_TRACE_SCOPE("jpeg decode");
   if (size < this->download_size_) {
     ESP_LOGV(TAG, "Download not complete. Size: %d/%d", size, this->download_size_);
     return 0;
@@ -73,10 +434,44 @@ int HOT JpegDecoder::decode(uint8_t *buffer, size_t size) {
 
   this->jpeg_.setUserPointer(this);
   this->jpeg_.setPixelType(RGB8888);
-  if (!this->set_size(this->jpeg_.getWidth(), this->jpeg_.getHeight())) {
+  int options = 0;
+  switch (this->scale_) {
+    case 2:
+      options = JPEG_SCALE_HALF;
+      break;
+    case 4:
+      options = JPEG_SCALE_QUARTER;
+      break;
+    case 8:
+      options = JPEG_SCALE_EIGHTH;
+      break;
+    default:
+      this->scale_ = 1;
+      break;
+  }
+  int width = std::max(1, this->jpeg_.getWidth() / this->scale_);
+  int height = std::max(1, this->jpeg_.getHeight() / this->scale_);
+  if (!this->set_size(width, height)) {
     return DECODE_ERROR_OUT_OF_MEMORY;
   }
-  if (!this->jpeg_.decode(0, 0, 0)) {
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+  const int threads = this->image_->get_decode_threads_();
+  std::vector<JpegBand> bands;
+  if (threads > 1 && this->plan_bands_(buffer, size, threads, bands)) {
+    // Each band opens its own data.
+    this->jpeg_.close();
+    if (!this->decode_parallel_(bands, buffer, options)) {
+      ESP_LOGE(TAG, "Error while decoding.");
+      return DECODE_ERROR_UNSUPPORTED_FORMAT;
+    }
+    this->decoded_bytes_ = size;
+    return size;
+  }
+  if (threads > 1) {
+    ESP_LOGD(TAG, "No restart markers to split the image at, decoding on one thread");
+  }
+#endif  // USE_LOCAL_IMAGE_PARALLEL_DECODE
+  if (!this->jpeg_.decode(0, 0, options)) {
     ESP_LOGE(TAG, "Error while decoding.");
     this->jpeg_.close();
     return DECODE_ERROR_UNSUPPORTED_FORMAT;
@@ -5,10 +5,45 @@
 // #define USE_ONLINE_IMAGE_PNG_SUPPORT
 #ifdef USE_ONLINE_IMAGE_JPEG_SUPPORT
 #include <JPEGDEC.h>
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
 
 namespace esphome {
 namespace local_image {
 
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+/** A band of rows decoded by one worker. */
+struct JpegBand {
+  class JpegDecoder *decoder;
+  /** Own decoder of a worker thread, nullptr for bands decoded on the loop thread. */
+  JPEGDEC *jpeg;
+  /** Image rows after scaling, from row_begin up to row_end (exclusive). */
+  int row_begin;
+  int row_end;
+  /** JPEG data of the band: the whole file, or a copy of the header with only the restart intervals of the band. */
+  uint8_t *data;
+  size_t size;
+  /** Row of the decoded JPEG at which the data of the band starts. */
+  int y_offset;
+  /** The decode was stopped after the last row of the band. */
+  bool stopped;
+  bool ok;
+};
+
+/** A worker thread with its own JPEGDEC, kept with the decoder across loads (see set_keep_decoder()). */
+struct JpegWorker {
+  JPEGDEC jpeg;
+  std::thread thread;
+  /** Band to decode, nullptr while idle. */
+  JpegBand *band{nullptr};
+};
+#endif  // USE_LOCAL_IMAGE_PARALLEL_DECODE
+
 /**
  * @brief Image decoder specialization for JPEG images.
  */
@@ -20,13 +55,48 @@ class JpegDecoder : public ImageDecoder {
    * @param display The image to decode the stream into.
    */
   JpegDecoder(LocalImage *image) : ImageDecoder(image) {}
-  ~JpegDecoder() override {}
+  ~JpegDecoder() override;
+
+  /** Decode at 1/scale of the image size (1, 2, 4 or 8), using less memory and time. */
+  void set_scale(uint8_t scale) { this->scale_ = scale; }
 
   int prepare(size_t download_size) override;
   int HOT decode(uint8_t *buffer, size_t size) override;
 
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+  /** Draw the pixels of a decoded block which belong to a band. Returns false once past the band. */
+  bool draw_band(JpegBand &band, JPEGDRAW *jpeg);
+#endif  // USE_LOCAL_IMAGE_PARALLEL_DECODE
+
  protected:
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+  /**
+   * @brief Split the image into horizontal bands, one per thread, at its restart markers. Each band
+   * but the first gets a copy of the JPEG header with only its own restart intervals.
+   *
+   * @return false if the image has no restart markers to split at, or there is no memory for the copies.
+   */
+  bool plan_bands_(uint8_t *buffer, size_t size, int threads, std::vector<JpegBand> &bands);
+  /** Decode the bands at the same time, each with its own JPEGDEC, and free their copies. */
+  bool decode_parallel_(std::vector<JpegBand> &bands, uint8_t *buffer, int options);
+  /** Decode a band with its own decoder, or with jpeg_ on the loop thread. */
+  void decode_band_(JpegBand &band, int options);
+  /** Start worker threads until there are count of them, fewer without memory. */
+  void start_workers_(size_t count);
+  void worker_loop_(JpegWorker *worker);
+#endif  // USE_LOCAL_IMAGE_PARALLEL_DECODE
+
   JPEGDEC jpeg_{};
+  uint8_t scale_{1};
+#ifdef USE_LOCAL_IMAGE_PARALLEL_DECODE
+  /** Rows of a band before bands are merged at long restart intervals. */
+  int band_rows_{0};
+  int band_options_{0};
+  std::vector<std::unique_ptr<JpegWorker>> workers_;
+  std::mutex workers_lock_;
+  std::condition_variable workers_cond_;
+  bool stop_workers_{false};
+#endif  // USE_LOCAL_IMAGE_PARALLEL_DECODE
 };
 
 }  // namespace local_image
@@ -0,0 +1,124 @@
+#include "load_scheduler.h"
+#include "local_image.h"
+
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+static const char *const TAG = "local_image.scheduler";
+
+namespace esphome {
+namespace local_image {
+
+void LoadScheduler::dump_config() {
+  ESP_LOGCONFIG(TAG, "LocalImage load scheduler:");
+  ESP_LOGCONFIG(TAG, "   Max active loads: %u", this->max_active_loads_);
+  if (this->memory_budget_ > 0) {
+    ESP_LOGCONFIG(TAG, "   Memory budget: %zu bytes", this->memory_budget_);
+  }
+  ESP_LOGCONFIG(TAG, "   Time slice: %" PRIu32 " ms", this->time_slice_);
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  ESP_LOGCONFIG(TAG, "   File cache: %zu bytes", global_file_cache.get_budget());
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
+}
+
+void LoadScheduler::request(LocalImage *image, const std::string &path) {
+  for (auto &active : this->active_) {
+    if (active.image == image) {
+      ESP_LOGD(TAG, "Cancel loading of %s, superseded by %s", image->path_.c_str(), path.c_str());
+      image->abort_load_();
+      this->remove_active_(image);
+      break;
+    }
+  }
+
+  for (auto &req : this->pending_) {
+    if (req.image == image) {
+      // Keep the place in the queue, only the latest path is of interest.
+      ESP_LOGV(TAG, "Replace pending request %s with %s", req.path.c_str(), path.c_str());
+      req.path = path;
+      return;
+    }
+  }
+  this->pending_.push_back(Request{image, path, this->sequence_++});
+}
+
+void LoadScheduler::cancel(LocalImage *image) {
+  for (auto it = this->pending_.begin(); it != this->pending_.end(); ++it) {
+    if (it->image == image) {
+      this->pending_.erase(it);
+      break;
+    }
+  }
+  for (auto &active : this->active_) {
+    if (active.image == image) {
+      image->abort_load_();
+      this->remove_active_(image);
+      break;
+    }
+  }
+}
+
+void LoadScheduler::remove_active_(LocalImage *image) {
+  for (auto it = this->active_.begin(); it != this->active_.end(); ++it) {
+    if (it->image == image) {
+      this->active_memory_ -= it->memory;
+      this->active_.erase(it);
+      return;
+    }
+  }
+}
+
+void LoadScheduler::start_pending_() {
+  while (!this->pending_.empty() && this->active_.size() < this->max_active_loads_) {
+    auto best = this->pending_.begin();
+    for (auto it = this->pending_.begin(); it != this->pending_.end(); ++it) {
+      int priority = it->image->get_priority();
+      int best_priority = best->image->get_priority();
+      if (priority > best_priority || (priority == best_priority && it->sequence < best->sequence)) {
+        best = it;
+      }
+    }
+
+    size_t memory = best->image->estimate_load_memory_(best->path);
+    if (!this->active_.empty() && this->memory_budget_ > 0 && this->active_memory_ + memory > this->memory_budget_) {
+      ESP_LOGV(TAG, "Delay loading %s, memory budget exceeded", best->path.c_str());
+      return;
+    }
+
+    Request req = *best;
+    this->pending_.erase(best);
+    if (req.image->start_load_(req.path)) {
+      this->active_.push_back(ActiveLoad{req.image, memory});
+      this->active_memory_ += memory;
+    }
+  }
+}
+
+void LoadScheduler::loop() {
+  if (this->is_idle()) {
+    return;
+  }
+  this->start_pending_();
+
+  uint32_t start = millis();
+  while (!this->active_.empty()) {
+    // Advance every running load by one chunk per round.
+    for (size_t i = 0; i < this->active_.size();) {
+      LocalImage *image = this->active_[i].image;
+      if (image->process_load_()) {
+        this->remove_active_(image);
+        this->start_pending_();
+      } else {
+        i++;
+      }
+    }
+    App.feed_wdt();
+    if (millis() - start >= this->time_slice_) {
+      break;
+    }
+  }
+}
+
+}  // namespace local_image
+}  // namespace esphome
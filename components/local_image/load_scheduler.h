@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace local_image {
+
+class LocalImage;
+
+/**
+ * @brief Shared loader that serializes image loads of all LocalImage instances.
+ *
+ * Load requests are queued instead of being executed right away. Repeated requests
+ * for the same image are collapsed to the latest path, a request for an image that
+ * is currently loading cancels that load, and pending requests are started by
+ * priority, as long as the memory used by running loads stays within the budget.
+ * Running loads are advanced chunk by chunk from loop(), within a time slice, so
+ * that other components keep running while images are decoded.
+ */
+class LoadScheduler : public Component {
+ public:
+  void loop() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::DATA; }
+
+  /** Maximum number of loads that are advanced at the same time. */
+  void set_max_active_loads(uint8_t max_active_loads) { this->max_active_loads_ = max_active_loads; }
+  /** Maximum memory used by running loads together, 0 for no limit. One load is always allowed to run. */
+  void set_memory_budget(size_t memory_budget) { this->memory_budget_ = memory_budget; }
+  /** Time spent on loading in each loop() call, in milliseconds. */
+  void set_time_slice(uint32_t time_slice) { this->time_slice_ = time_slice; }
+
+  /**
+   * @brief Queue loading an image from a path.
+   *
+   * Replaces a pending request for the same image and cancels its load if it is
+   * currently running.
+   */
+  void request(LocalImage *image, const std::string &path);
+
+  /** Drop the pending request and cancel the running load of an image, if any. */
+  void cancel(LocalImage *image);
+
+  bool is_idle() const { return this->pending_.empty() && this->active_.empty(); }
+
+ protected:
+  struct Request {
+    LocalImage *image;
+    std::string path;
+    uint32_t sequence;
+  };
+
+  struct ActiveLoad {
+    LocalImage *image;
+    size_t memory;
+  };
+
+  /** Start pending requests, best priority first, while the limits allow it. */
+  void start_pending_();
+  void remove_active_(LocalImage *image);
+
+  std::vector<Request> pending_;
+  std::vector<ActiveLoad> active_;
+  size_t active_memory_{0};
+  uint32_t sequence_{0};
+
+  uint8_t max_active_loads_{1};
+  size_t memory_budget_{0};
+  uint32_t time_slice_{20};
+};
+
+}  // namespace local_image
+}  // namespace esphome
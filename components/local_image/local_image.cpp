@@ -1,10 +1,14 @@
 #include "local_image.h"
 
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
 #include "esphome/core/log.h"
 
 static const char *const TAG = "local_image";
 
 #include "image_decoder.h"
+#include "load_scheduler.h"
+#include "trace.h"
 
 #ifdef USE_ONLINE_IMAGE_BMP_SUPPORT
 #include "bmp_image.h"
@@ -15,6 +19,9 @@ static const char *const TAG = "local_image";
 #ifdef USE_ONLINE_IMAGE_PNG_SUPPORT
 #include "png_image.h"
 #endif
+#ifdef USE_LOCAL_IMAGE_QOI_SUPPORT
+#include "qoi_image.h"
+#endif
 
 namespace esphome {
 namespace local_image {
@@ -22,6 +29,136 @@ namespace local_image {
 using image::ImageType;
 using storage::FileProvider;
 
+/** More changed regions than this are reported as their bounding box. */
+static const size_t MAX_DIRTY_RECTS = 16;
+
+// RGB565 is stored the way LVGL reads it, so that the buffer can be handed to LVGL without conversion.
+#if defined(USE_LVGL) && LV_COLOR_DEPTH == 16 && !LV_COLOR_16_SWAP
+static constexpr bool RGB565_BIG_ENDIAN = false;
+#else
+static constexpr bool RGB565_BIG_ENDIAN = true;
+#endif
+
+/** Number of bytes hashed by FINGERPRINT_HEAD. */
+static const size_t FINGERPRINT_HEAD_SIZE = 4096;
+static const uint32_t FNV1A_OFFSET = 2166136261UL;
+
+static uint32_t fnv1a_update(uint32_t hash, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hash ^= data[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+/** 4x4 Bayer matrix for ordered dithering, thresholds 0..15. */
+static const uint8_t BAYER4[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+
+/**
+ * Reduce an 8 bit channel to the given number of bits. With a dither threshold (0..15)
+ * the value is first offset by -1/2..+1/2 of a quantization step.
+ */
+static inline uint8_t quantize_channel(uint8_t value, uint8_t bits, int threshold) {
+  const int levels = (1 << bits) - 1;
+  int v = value;
+  if (threshold >= 0) {
+    v += ((2 * threshold - 15) * 255) / (32 * levels);
+    v = v < 0 ? 0 : (v > 255 ? 255 : v);
+  }
+  return (v * levels + 127) / 255;
+}
+
+/** Memory pngle allocates for its state and inflate window, not visible to sizeof. */
+static const size_t PNGLE_STATE_SIZE = 44 * 1024;
+
+/** Delays between attempts to load while the storage is not ready, in milliseconds. */
+static const uint32_t LOAD_RETRY_MIN_DELAY = 100;
+static const uint32_t LOAD_RETRY_MAX_DELAY = 10000;
+
+/** (src * alpha + dst * (255 - alpha)) / 255, rounded. */
+static inline uint8_t blend_channel(uint8_t src, uint8_t dst, uint8_t alpha) {
+  uint32_t value = src * alpha + dst * (255 - alpha) + 128;
+  return (value + (value >> 8)) >> 8;
+}
+
+/** Blend a color over another one, with the alpha of the result. */
+static Color blend_color(Color src, Color dst, uint8_t alpha) {
+  if (dst.w == 0)
+    return Color(src.r, src.g, src.b, alpha);
+  return Color(blend_channel(src.r, dst.r, alpha), blend_channel(src.g, dst.g, alpha),
+               blend_channel(src.b, dst.b, alpha), blend_channel(0xFF, dst.w, alpha));
+}
+
+/**
+ * Whether the first bytes of a PNG file announce Adam7 interlacing, whose passes
+ * revisit rows which have already been written.
+ */
+static bool is_interlaced_png(const uint8_t *data, size_t len) { return len > 28 && data[28] != 0; }
+
+/**
+ * Get the image size from the first bytes of a file.
+ *
+ * @return false if the header is not (completely) in the data.
+ */
+static bool probe_image_size(ImageFormat format, const uint8_t *data, size_t len, int &width, int &height) {
+  switch (format) {
+    case ImageFormat::PNG:
+      // Signature, then the IHDR chunk: length, type, width, height (big-endian).
+      if (len < 24)
+        return false;
+      width = encode_uint32(data[16], data[17], data[18], data[19]);
+      height = encode_uint32(data[20], data[21], data[22], data[23]);
+      return true;
+    case ImageFormat::BMP:
+      if (len < 26)
+        return false;
+      width = encode_uint32(data[21], data[20], data[19], data[18]);
+      height = std::abs(static_cast<int32_t>(encode_uint32(data[25], data[24], data[23], data[22])));
+      return true;
+    case ImageFormat::QOI:
+      if (len < 12)
+        return false;
+      width = encode_uint32(data[4], data[5], data[6], data[7]);
+      height = encode_uint32(data[8], data[9], data[10], data[11]);
+      return true;
+    case ImageFormat::JPEG: {
+      // Walk the marker segments up to the start of frame.
+      size_t pos = 2;
+      while (pos + 9 <= len) {
+        if (data[pos] != 0xFF)
+          return false;
+        uint8_t marker = data[pos + 1];
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+          height = encode_uint16(data[pos + 5], data[pos + 6]);
+          width = encode_uint16(data[pos + 7], data[pos + 8]);
+          return true;
+        }
+        pos += 2 + encode_uint16(data[pos + 2], data[pos + 3]);
+      }
+      return false;
+    }
+    default:
+      return false;
+  }
+}
+
+/**
+ * Free memory of one memory type, as seen by the load planner.
+ */
+struct HeapRegion {
+  size_t free;
+  size_t block;
+
+  bool take(size_t size) {
+    if (size > this->block || size > this->free)
+      return false;
+    // Conservative: assume the allocation is cut from the largest block.
+    this->block -= size;
+    this->free -= size;
+    return true;
+  }
+};
+
 inline bool is_color_on(const Color &color) {
   // This produces the most accurate monochrome conversion, but is slightly slower.
   //  return (0.2125 * color.r + 0.7154 * color.g + 0.0721 * color.b) > 127;
@@ -59,6 +196,10 @@ void LocalImage::dump_config() {
       break;
     case BMP:
       ESP_LOGCONFIG(TAG, "   Format: %s", "BMP");
+      break;
+    case QOI:
+      ESP_LOGCONFIG(TAG, "   Format: %s", "QOI");
+      break;
     default:
       ESP_LOGCONFIG(TAG, "   Format: %s", "AUTO");
   }
@@ -77,25 +218,115 @@ void LocalImage::dump_config() {
       break;
   }
 
+  if (this->use_mask_) {
+    ESP_LOGCONFIG(TAG, "   Transparency: mask");
+  }
+  if (this->load_on_ != LOAD_ON_BOOT) {
+    ESP_LOGCONFIG(TAG, "   Load on: %s", this->load_on_ == LOAD_ON_FIRST_DRAW ? "first draw" : "manual");
+  }
   ESP_LOGCONFIG(TAG, "   Width: %d", this->get_width());
   ESP_LOGCONFIG(TAG, "   Height: %d", this->get_height());
   ESP_LOGCONFIG(TAG, "   Path: %s", this->path_.c_str());
+  if (this->rotation_ != 0 || this->mirror_x_ || this->mirror_y_) {
+    ESP_LOGCONFIG(TAG, "   Rotation: %d, mirror x: %s, mirror y: %s", this->rotation_, YESNO(this->mirror_x_),
+                  YESNO(this->mirror_y_));
+  }
+  if (this->fingerprint_mode_ != FINGERPRINT_NONE) {
+    ESP_LOGCONFIG(TAG, "   Fingerprint mode: %d", this->fingerprint_mode_);
+  }
+  if (this->watch_interval_ > 0) {
+    ESP_LOGCONFIG(TAG, "   Watch interval: %" PRIu32 " ms", this->watch_interval_);
+  }
+  ESP_LOGCONFIG(TAG, "   Priority: %d", this->priority_);
+  ESP_LOGCONFIG(TAG, "   Keep decoder: %s", YESNO(this->keep_decoder_));
+  if (this->progressive_) {
+    ESP_LOGCONFIG(TAG, "   Progressive, progress interval: %" PRIu32 " ms", this->progress_interval_);
+  }
+  ESP_LOGCONFIG(TAG, "   Read buffer: %zu bytes%s", this->read_chunk_size_, this->read_ahead_enabled_ ? ", read ahead" : "");
+  if (this->compression_ == COMPRESSION_RLE) {
+    ESP_LOGCONFIG(TAG, "   Compression: %s", "RLE");
+  }
+  switch (this->packing_) {
+    case PACKING_GRAY2:
+      ESP_LOGCONFIG(TAG, "   Packing: %s", "GRAY2");
+      break;
+    case PACKING_GRAY4:
+      ESP_LOGCONFIG(TAG, "   Packing: %s", "GRAY4");
+      break;
+    case PACKING_RGB332:
+      ESP_LOGCONFIG(TAG, "   Packing: %s", "RGB332");
+      break;
+    default:
+      break;
+  }
+  if (this->dither_ == DITHER_ORDERED) {
+    ESP_LOGCONFIG(TAG, "   Dither: %s", "ORDERED");
+  }
+  if (this->load_stats_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "   Statistics: YES");
+  }
 };
 
 void LocalImage::setup() {
-  if (this->provider_->is_ready()) {
-    this->load_image();
+  if (this->load_on_ == LOAD_ON_BOOT) {
+    // Loaded from loop(), so that setup of the other components is not delayed.
+    this->defer_load_();
   }
 };
 
+void LocalImage::defer_load_() {
+  this->load_deferred_ = true;
+  this->retry_at_ = millis();
+  this->retry_delay_ = 0;
+}
+
 void LocalImage::set_path(const std::string &path) { this->path_ = path; }
 
+void LocalImage::set_packing(PixelPacking packing) {
+  this->packing_ = packing;
+  switch (packing) {
+    case PACKING_GRAY2:
+      this->bpp_ = 2;
+      break;
+    case PACKING_GRAY4:
+      this->bpp_ = 4;
+      break;
+    case PACKING_RGB332:
+      this->bpp_ = 8;
+      break;
+    default:
+      break;
+  }
+  this->loaded_fingerprint_.valid = false;
+}
+
 void LocalImage::set_storage(storage::FileProvider *file_provider) { this->provider_ = file_provider; }
 
 void LocalImage::draw(int x, int y, display::Display *display, Color color_on, Color color_off) {
   ESP_LOGD(TAG, "Draw image.");
+  if (this->load_on_ == LOAD_ON_FIRST_DRAW && !this->first_draw_) {
+    this->first_draw_ = true;
+    this->defer_load_();
+  }
 
-  if (this->buffer_) {
+  if (this->progressive_ && this->loading_ && this->buffer_ != nullptr) {
+    // Show the rows decoded so far over the placeholder.
+    if (this->placeholder_) {
+      this->placeholder_->draw(x, y, display, color_on, color_off);
+    }
+    display::Rect area = this->get_revealed_area();
+    if (area.is_set()) {
+      this->draw_rows_(x, y, display, color_on, color_off, area);
+    }
+    return;
+  }
+  if (this->is_drawable_() &&
+      (!this->compressed_.empty() || this->packing_ != PACKING_NONE || this->mask_ != nullptr ||
+       !this->color_lut_.empty() || (!RGB565_BIG_ENDIAN && this->type_ == ImageType::IMAGE_TYPE_RGB565))) {
+    // The base class can read neither compressed rows, packed pixels, the mask nor little endian RGB565,
+    // and knows nothing of the color transform.
+    this->draw_rows_(x, y, display, color_on, color_off, display::Rect(0, 0, this->width_, this->height_));
+  } else if (this->is_drawable_() && this->data_start_ != nullptr) {
     Image::draw(x, y, display, color_on, color_off);
   } else if (this->placeholder_) {
     this->placeholder_->draw(x, y, display, color_on, color_off);
@@ -113,14 +344,30 @@ void LocalImage::free_source_buffer_() {
     this->decoder_.reset();
     this->decoder_ = nullptr;
   }
+  this->overlay_decoder_.reset();
 }
 
 void LocalImage::free_image_buffer_() {
-  if (this->buffer_ != nullptr) {
+  this->loaded_fingerprint_.valid = false;
+  if (this->line_buffer_ != nullptr) {
+    this->allocator_.deallocate(this->line_buffer_, this->line_buffer_size_);
+    this->line_buffer_ = nullptr;
+    this->line_buffer_size_ = 0;
+  }
+  if (this->buffer_ != nullptr || !this->compressed_.empty()) {
     ESP_LOGV(TAG, "Deallocating image buffer...");
-    this->allocator_.deallocate(this->buffer_, this->get_buffer_size_());
+    if (this->buffer_ != nullptr) {
+      this->allocator_.deallocate(this->buffer_, this->get_buffer_size_());
+    }
+    this->compressed_.clear();
+    if (this->mask_ != nullptr) {
+      this->allocator_.deallocate(this->mask_, this->mask_size_);
+      this->mask_ = nullptr;
+      this->mask_size_ = 0;
+    }
     this->data_start_ = nullptr;
     this->buffer_ = nullptr;
+    this->buffer_complete_ = false;
     this->width_ = 0;
     this->height_ = 0;
     this->buffer_width_ = 0;
@@ -131,6 +378,17 @@ void LocalImage::free_image_buffer_() {
 size_t LocalImage::create_image_buffer(int width_in, int height_in) {
   int width = this->fixed_width_;
   int height = this->fixed_height_;
+  if (this->is_direct_()) {
+    // Only the size is needed, the band is allocated once the decoder draws.
+    if (this->is_auto_resize_()) {
+      width = width_in;
+      height = height_in;
+    }
+    this->buffer_width_ = width;
+    this->buffer_height_ = height;
+    this->band_index_ = -1;
+    return static_cast<size_t>(width) * height;
+  }
   if (this->is_auto_resize_()) {
     width = width_in;
     height = height_in;
@@ -139,17 +397,36 @@ size_t LocalImage::create_image_buffer(int width_in, int height_in) {
     }
   }
 
+  if (!this->compressed_.empty()) {
+    // The previous image is only held compressed, the decoder needs a plain buffer again.
+    // With the same size, keep it to find the changed pixels once the new image is compressed.
+    if (width == this->buffer_width_ && height == this->buffer_height_) {
+      this->previous_.swap(this->compressed_);
+    }
+    this->free_image_buffer_();
+  }
+
   size_t new_size = this->get_buffer_size_(width, height);
   if ((this->buffer_ != nullptr) && (new_size <= this->get_buffer_size_())) {
     ESP_LOGD(TAG, "Image buffer do not need to allocate");
     // Buffer already allocated => no need to resize
-    return new_size;
+    if (width != this->buffer_width_ || height != this->buffer_height_) {
+      // Same memory, different layout: the old content means nothing anymore.
+      this->buffer_complete_ = false;
+      this->buffer_width_ = width;
+      this->buffer_height_ = height;
+      this->width_ = width;
+      this->height_ = height;
+      this->mark_all_changed_();
+    }
+    return this->allocate_mask_() ? new_size : 0;
   }
   // if (new_size > this->get_buffer_size_()) {
   this->free_image_buffer_();
   // }
 
   ESP_LOGD(TAG, "Allocating new buffer of %zu bytes", new_size);
+  LOCAL_IMAGE_TRACE_SCOPE("alloc image buffer");
   this->buffer_ = this->allocator_.allocate(new_size);
   if (this->buffer_ == nullptr) {
     ESP_LOGE(TAG, "allocation of %zu bytes failed. Biggest block in heap: %zu Bytes", new_size,
@@ -158,223 +435,1925 @@ size_t LocalImage::create_image_buffer(int width_in, int height_in) {
     return 0;
   }
 
+  this->buffer_complete_ = false;
   this->buffer_width_ = width;
   this->buffer_height_ = height;
   this->width_ = width;
   this->height_ = height;
+  this->mark_all_changed_();
   ESP_LOGV(TAG, "New size: (%d, %d)", width, height);
-  return new_size;
+  return this->allocate_mask_() ? new_size : 0;
 }
 
-//------------------------------------------------------------------
-//
-void LocalImage::load_image() {
-  size_t file_size = 0;
-  size_t read_bytes = 0;
-  this->last_error_ = ErrorCode::OK;
-
-  //
-  //  If free memory from previous loading. if any.
-  //
-  if (this->source_buffer_ != nullptr) {
-    this->free_source_buffer_();
+void LocalImage::select_band_(int index, int y1, int y2) {
+  this->flush_band_();
+  this->band_index_ = index;
+  // Corners of the decoded rows y1..y2 where they are shown, after mirroring and rotation.
+  int ax = 0;
+  int ay = y1;
+  int bx = this->get_decode_width_() - 1;
+  int by = y2 - 1;
+  if (this->rotation_ != 0 || this->mirror_x_ || this->mirror_y_) {
+    this->transform_position_(ax, ay);
+    this->transform_position_(bx, by);
   }
+  this->band_area_ = display::Rect(std::min(ax, bx), std::min(ay, by), std::abs(bx - ax) + 1, std::abs(by - ay) + 1);
 
-  ESP_LOGD(TAG, "Loading image from file : %s", this->path_.c_str());
+  size_t size = static_cast<size_t>(this->band_area_.w) * this->band_area_.h * this->get_direct_bpp_();
+  if (size > this->band_size_) {
+    this->free_band_();
+    this->band_ = this->allocator_.allocate(size);
+    if (this->band_ == nullptr) {
+      ESP_LOGE(TAG, "allocation of %zu bytes for the band failed", size);
+      this->last_error_ = ErrorCode::NO_MEM;
+      return;
+    }
+    this->band_size_ = size;
+  }
+}
 
-  file_size = this->provider_->get_size(this->path_);
-  if ((file_size == 0) || (this->provider_->error() != 0)) {
-    ESP_LOGE(TAG, "File %s check error: %s", path_.c_str(), this->provider_->error_str());
-    this->last_error_ = ErrorCode::FILE_NOT_NOTFOUND;
+void LocalImage::flush_band_() {
+  if (this->band_ == nullptr || this->band_index_ < 0) {
     return;
   }
+  LOCAL_IMAGE_TRACE_SCOPE("flush band");
+  this->direct_.display->draw_pixels_at(
+      this->direct_.x + this->band_area_.x, this->direct_.y + this->band_area_.y, this->band_area_.w,
+      this->band_area_.h, this->band_, display::COLOR_ORDER_RGB,
+      this->get_direct_bpp_() == 3 ? display::COLOR_BITNESS_888 : display::COLOR_BITNESS_565, true);
+  this->band_index_ = -1;
+}
 
-  //
-  //    Get Memory for read file
-  //
-  this->source_buffer_ = this->allocator_.allocate(file_size);
-  if (this->source_buffer_ == nullptr) {
-    ESP_LOGE(TAG, "No memory. (Size: %zu)", file_size);
-    this->last_error_ = ErrorCode::NO_MEM;
-    return;
+void LocalImage::free_band_() {
+  if (this->band_ != nullptr) {
+    this->allocator_.deallocate(this->band_, this->band_size_);
+    this->band_ = nullptr;
   }
-  this->source_size_ = file_size;
+  this->band_size_ = 0;
+  this->band_index_ = -1;
+}
 
-  //
-  //   Read file
-  //
-  ESP_LOGD(TAG, "Read file: %s. Size=%d", path_.c_str(), file_size);
-  storage::FileObj *file = this->provider_->open_file(path_, storage::OPEN_READ);
-  if (this->provider_->error() != 0) {
-    ESP_LOGE(TAG, "Error open file %s : %s ", path_.c_str(), this->provider_->error_str());
+void LocalImage::draw_band_pixel_(int x, int y, Color color) {
+  if (this->band_ == nullptr) {
+    return;
   }
-  read_bytes = file->read(this->source_buffer_, this->source_size_);
-  if (file->error() != 0) {
-    ESP_LOGE(TAG, "Error reading file %s : %s", path_.c_str(), this->provider_->error_str());
-    this->free_source_buffer_();
+  if (this->rotation_ != 0 || this->mirror_x_ || this->mirror_y_) {
+    this->transform_position_(x, y);
+  }
+  x -= this->band_area_.x;
+  y -= this->band_area_.y;
+  if (x < 0 || y < 0 || x >= this->band_area_.w || y >= this->band_area_.h) {
     return;
   }
-  delete file;  // ???
-  ESP_LOGD(TAG, "Read %d bytes", read_bytes);
-  if (read_bytes < this->source_size_) {
-    ESP_LOGW(TAG, "Expect %d bytes, but read %d bytes.", this->source_size_, read_bytes);
+  uint8_t *pos = this->band_ + (y * this->band_area_.w + x) * this->get_direct_bpp_();
+  if (this->get_direct_bpp_() == 3) {
+    pos[0] = color.r;
+    pos[1] = color.g;
+    pos[2] = color.b;
+  } else {
+    uint16_t rgb565 = display::ColorUtil::color_to_565(color);
+    pos[0] = rgb565 >> 8;
+    pos[1] = rgb565 & 0xFF;
   }
+}
 
-  //
-  //  Prepare Decoder
-  //
-#ifdef USE_ONLINE_IMAGE_BMP_SUPPORT
-  if (this->format_ == ImageFormat::BMP) {
-    ESP_LOGD(TAG, "Allocating BMP decoder");
-    this->decoder_ = make_unique<BmpDecoder>(this);
+bool LocalImage::allocate_mask_() {
+  size_t size = this->get_mask_size_(this->buffer_width_, this->buffer_height_);
+  if (size == 0 || (this->mask_ != nullptr && size <= this->mask_size_)) {
+    return true;
   }
-#endif  // ONLINE_IMAGE_BMP_SUPPORT
-#ifdef USE_ONLINE_IMAGE_JPEG_SUPPORT
-  if (this->format_ == ImageFormat::JPEG) {
-    ESP_LOGD(TAG, "Allocating JPEG decoder");
-    this->decoder_ = esphome::make_unique<JpegDecoder>(this);
+  if (this->mask_ != nullptr) {
+    this->allocator_.deallocate(this->mask_, this->mask_size_);
   }
-#endif  // USE_ONLINE_IMAGE_JPEG_SUPPORT
-#ifdef USE_ONLINE_IMAGE_PNG_SUPPORT
-  if (this->format_ == ImageFormat::PNG) {
-    ESP_LOGD(TAG, "Allocating PNG decoder");
-    this->decoder_ = make_unique<PngDecoder>(this);
+  this->mask_ = this->allocator_.allocate(size);
+  if (this->mask_ == nullptr) {
+    this->mask_size_ = 0;
+    ESP_LOGE(TAG, "allocation of %zu bytes for the mask failed", size);
+    this->last_error_ = ErrorCode::NO_MEM;
+    return false;
   }
-#endif  // ONLINE_IMAGE_PNG_SUPPORT
+  this->mask_size_ = size;
+  memset(this->mask_, 0, size);
+  return true;
+}
 
-  if (!this->decoder_) {
-    ESP_LOGE(TAG, "Could not instantiate decoder. Image format unsupported: %d", this->format_);
-    this->last_error_ = ErrorCode::DECODER_NOT_INIT;
-    this->free_source_buffer_();
+//------------------------------------------------------------------
+//
+void LocalImage::request_load(const std::string &path) {
+  this->watch_request_ = false;
+  if (!this->provider_->is_ready()) {
+    ESP_LOGD(TAG, "Storage not ready, loading %s later", path.c_str());
+    this->set_path(path);
+    if (!this->load_deferred_) {
+      this->defer_load_();
+    }
     return;
   }
+  this->load_deferred_ = false;
+  if (this->scheduler_ != nullptr) {
+    this->scheduler_->request(this, path);
+  } else {
+    this->set_path(path);
+    this->load_image();
+  }
+}
 
-  if (this->decoder_->prepare(read_bytes) < 0) {
-    ESP_LOGE(TAG, "Error when prepare decoder.");
-    this->last_error_ = ErrorCode::DECODER_NOT_PREPARE;
-    this->free_source_buffer_();
+void LocalImage::draw_direct(display::Display *display, int x, int y, const std::string &path) {
+  this->direct_pending_ = DirectTarget{display, x, y};
+  this->request_load(path);
+}
+
+void LocalImage::load_image() {
+  LOCAL_IMAGE_TRACE_SCOPE("load_image");
+  if (!this->start_load_(this->path_)) {
     return;
   }
+  while (!this->process_load_()) {
+    App.feed_wdt();
+  }
+}
 
-  auto fed = this->decoder_->decode(this->source_buffer_, this->source_size_);
-  if (fed < 0) {
-    ESP_LOGE(TAG, "Error decoding image %d", fed);
-    this->last_error_ = ErrorCode::DECODER_PROC_ERR;
-
-  } else {
-    //
-    // Pass prepared patas to parent Image class
-    //
-    this->data_start_ = this->buffer_;
-    this->width_ = buffer_width_;
-    this->height_ = buffer_height_;
-    this->image_loaded_ = true;
-    ESP_LOGD(TAG, "Image fully loaded, read %zu bytes, width/height = %d/%d", fed, this->width_, this->height_);
+void LocalImage::update_fingerprint_(const uint8_t *data, size_t len) {
+  if (this->fingerprint_mode_ == FINGERPRINT_HEAD) {
+    if (this->file_offset_ >= FINGERPRINT_HEAD_SIZE) {
+      return;
+    }
+    len = std::min(len, FINGERPRINT_HEAD_SIZE - this->file_offset_);
+  } else if (this->fingerprint_mode_ != FINGERPRINT_FULL) {
+    return;
   }
+  this->load_hash_ = fnv1a_update(this->load_hash_, data, len);
+}
 
-  this->free_source_buffer_();
+bool LocalImage::sizes_changed_(bool strict) {
+  // Only the sizes are read, hashes are checked chunk by chunk by process_check_().
+  size_t size = this->provider_->get_size(this->loaded_path_);
+  bool readable = size != 0 && this->provider_->error() == 0;
+  if (readable ? size != this->loaded_fingerprint_.size : strict) {
+    ESP_LOGD(TAG, "File %s changed", this->loaded_path_.c_str());
+    return true;
+  }
+  for (auto &overlay : this->overlays_) {
+    size = this->provider_->get_size(overlay.path);
+    readable = size != 0 && this->provider_->error() == 0;
+    // An overlay left out has no valid fingerprint, so a requested load tries it again.
+    if (!overlay.fingerprint.valid ? strict : readable ? size != overlay.fingerprint.size : strict) {
+      ESP_LOGD(TAG, "Overlay %s changed", overlay.path.c_str());
+      return true;
+    }
+  }
+  return false;
 }
 
-/**********************************************************************************************
- *
- * @brief Do load and decode image.
- *
- */
-void LocalImage::loop() {
-  if (this->image_loaded_) {
-    this->load_finished_callback_.call();
-    this->image_loaded_ = false;
+bool LocalImage::start_check_() {
+  if (this->source_size_ < this->read_chunk_size_ && this->resize_source_buffer(this->read_chunk_size_) == 0) {
+    return false;
   }
+  this->check_index_ = -1;
+  this->checking_ = this->open_check_file_();
+  return this->checking_;
+}
 
-  if (this->last_error_ != ErrorCode::OK) {
-    this->on_err_callback_.call(static_cast<uint8_t>(this->last_error_));
-    this->last_error_ = ErrorCode::OK;
+bool LocalImage::open_check_file_() {
+  const std::string &path = this->check_index_ < 0 ? this->loaded_path_ : this->overlays_[this->check_index_].path;
+  this->file_size_ = this->check_index_ < 0 ? this->loaded_fingerprint_.size
+                                            : this->overlays_[this->check_index_].fingerprint.size;
+  this->file_offset_ = 0;
+  this->load_hash_ = FNV1A_OFFSET;
+  // Always from storage, the file cache may hold the old version.
+  this->file_ = this->provider_->open_file(path, storage::OPEN_READ);
+  if (this->file_ == nullptr || this->provider_->error() != 0) {
+    ESP_LOGD(TAG, "File %s can not be read", path.c_str());
+    return false;
   }
-  return;
+  return true;
 }
 
-void LocalImage::map_chroma_key(Color &color) {
-  if (this->transparency_ == image::TRANSPARENCY_CHROMA_KEY) {
-    if (color.g == 1 && color.r == 0 && color.b == 0) {
-      color.g = 0;
+bool LocalImage::process_check_() {
+  size_t limit = this->file_size_;
+  if (this->fingerprint_mode_ == FINGERPRINT_HEAD) {
+    limit = std::min(limit, FINGERPRINT_HEAD_SIZE);
+  }
+  bool changed = false;
+  if (this->file_offset_ < limit) {
+    size_t want = std::min(this->source_size_, limit - this->file_offset_);
+    size_t read_bytes = this->file_->read(this->source_buffer_, want);
+    if (this->file_->error() != 0 || read_bytes == 0) {
+      changed = true;
+    } else {
+      this->update_fingerprint_(this->source_buffer_, read_bytes);
+      this->file_offset_ += read_bytes;
+      if (this->file_offset_ < limit) {
+        return false;
+      }
     }
-    if (color.w < 0x80) {
-      color.r = 0;
-      color.g = this->type_ == ImageType::IMAGE_TYPE_RGB565 ? 4 : 1;
-      color.b = 0;
+  }
+  if (!changed) {
+    uint32_t hash = this->check_index_ < 0 ? this->loaded_fingerprint_.hash
+                                           : this->overlays_[this->check_index_].fingerprint.hash;
+    changed = this->load_hash_ != hash;
+  }
+  delete this->file_;
+  this->file_ = nullptr;
+
+  if (!changed && ++this->check_index_ < static_cast<int>(this->overlays_.size())) {
+    if (this->open_check_file_()) {
+      return false;
     }
+    changed = true;
+  }
+  this->checking_ = false;
+  if (!changed) {
+    ESP_LOGV(TAG, "File %s unchanged, skip loading", this->path_.c_str());
+    this->release_decoder_();
+    return true;
   }
+  ESP_LOGD(TAG, "File %s or its overlays changed", this->path_.c_str());
+  this->forget_cached_files_();
+  return !this->begin_load_();
 }
 
-void LocalImage::draw_pixel_(int x, int y, Color color) {
-  if (!this->buffer_) {
-    ESP_LOGE(TAG, "Buffer not allocated!");
-    return;
+void LocalImage::forget_cached_files_() {
+  this->forget_cached_(this->loaded_path_);
+  for (auto &overlay : this->overlays_) {
+    this->forget_cached_(overlay.path);
   }
-  if (x < 0 || y < 0 || x >= this->buffer_width_ || y >= this->buffer_height_) {
-    ESP_LOGE(TAG, "Tried to paint a pixel (%d,%d) outside the image!", x, y);
-    return;
+}
+
+void LocalImage::forget_cached_(const std::string &path) {
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  global_file_cache.forget(path);
+#endif
+}
+
+size_t LocalImage::direct_band_memory_(int width, int height) const {
+  // One row more for scaling, along the longer side in case of rotation.
+  return static_cast<size_t>(std::max(width, height)) * (DIRECT_BAND_ROWS + 1) * this->get_direct_bpp_();
+}
+
+size_t LocalImage::estimate_load_memory_(const std::string &path) {
+  size_t file_size = this->provider_->get_size(path);
+  size_t source = this->format_ == ImageFormat::JPEG ? file_size : std::min(file_size, this->read_chunk_size_);
+  if (this->read_ahead_enabled_) {
+    source += 2 * this->read_chunk_size_;
   }
-  uint32_t pos = this->get_position_(x, y);
-  switch (this->type_) {
-    case ImageType::IMAGE_TYPE_BINARY: {
-      const uint32_t width_8 = ((this->width_ + 7u) / 8u) * 8u;
-      pos = x + y * width_8;
-      auto bitno = 0x80 >> (pos % 8u);
-      pos /= 8u;
-      auto on = is_color_on(color);
-      if (this->has_transparency() && color.w < 0x80)
-        on = false;
-      if (on) {
-        this->buffer_[pos] |= bitno;
-      } else {
-        this->buffer_[pos] &= ~bitno;
-      }
-      break;
+  if (this->direct_pending_.display != nullptr) {
+    // The image size is not known yet, assume the display size.
+    return source + this->direct_band_memory_(this->direct_pending_.display->get_width(),
+                                              this->direct_pending_.display->get_height());
+  }
+  return source + this->get_buffer_size_() + this->get_mask_size_(this->buffer_width_, this->buffer_height_);
+}
+
+size_t LocalImage::decoder_memory_() const {
+  switch (this->format_) {
+#ifdef USE_ONLINE_IMAGE_BMP_SUPPORT
+    case ImageFormat::BMP:
+      return sizeof(BmpDecoder);
+#endif
+#ifdef USE_ONLINE_IMAGE_JPEG_SUPPORT
+    case ImageFormat::JPEG:
+      return sizeof(JpegDecoder);
+#endif
+#ifdef USE_ONLINE_IMAGE_PNG_SUPPORT
+    case ImageFormat::PNG:
+      return sizeof(PngDecoder) + PNGLE_STATE_SIZE;
+#endif
+#ifdef USE_LOCAL_IMAGE_QOI_SUPPORT
+    case ImageFormat::QOI:
+      return sizeof(QoiDecoder);
+#endif
+    default:
+      return 0;
+  }
+}
+
+bool LocalImage::plan_fits_(LoadPlan &plan, int width, int height) const {
+  // Allocations still to be made by the load, with the memory they may use.
+  struct Need {
+    size_t size;
+    bool internal_first;
+  };
+  Need needs[5];
+  size_t count = 0;
+
+  if (this->is_auto_resize_()) {
+    width /= plan.jpeg_scale;
+    height /= plan.jpeg_scale;
+    if (this->is_swapped_())
+      std::swap(width, height);
+  } else {
+    width = this->fixed_width_;
+    height = this->fixed_height_;
+  }
+  size_t image = this->is_direct_() ? this->direct_band_memory_(width, height) : this->get_buffer_size_(width, height);
+  if (this->is_direct_() ? image > this->band_size_ : this->buffer_ == nullptr || image > this->get_buffer_size_()) {
+    needs[count++] = Need{image, false};
+  }
+  size_t mask = this->get_mask_size_(width, height);
+  if (mask > this->mask_size_) {
+    needs[count++] = Need{mask, false};
+  }
+  if (this->format_ == ImageFormat::JPEG && !this->is_cached_() && this->source_size_ < this->file_size_) {
+    // Grown with realloc, which may need a new block of the full size.
+    needs[count++] = Need{this->file_size_, false};
+  }
+  if (this->decoder_ == nullptr) {
+    needs[count++] = Need{this->decoder_memory_(), true};
+  }
+  if (plan.read_ahead) {
+    // Two DMA capable blocks, see ReadAhead.
+    size_t block = (this->read_chunk_size_ + 511) / 512 * 512;
+    needs[count++] = Need{2 * block, true};
+  }
+  std::sort(needs, needs + count, [](const Need &a, const Need &b) { return a.size > b.size; });
+
+  RAMAllocator<uint8_t> internal_allocator(RAMAllocator<uint8_t>::ALLOC_INTERNAL);
+  RAMAllocator<uint8_t> external_allocator(RAMAllocator<uint8_t>::ALLOC_EXTERNAL);
+  HeapRegion internal{internal_allocator.get_free_heap_size(), internal_allocator.get_max_free_block_size()};
+  HeapRegion external{external_allocator.get_free_heap_size(), external_allocator.get_max_free_block_size()};
+
+  plan.memory = 0;
+  for (size_t i = 0; i < count; i++) {
+    HeapRegion &first = needs[i].internal_first ? internal : external;
+    HeapRegion &second = needs[i].internal_first ? external : internal;
+    if (!first.take(needs[i].size) && !second.take(needs[i].size)) {
+      ESP_LOGV(TAG, "Plan read ahead %s, scale 1/%u: %zu bytes do not fit (largest blocks %zu / %zu)",
+               YESNO(plan.read_ahead), plan.jpeg_scale, needs[i].size, internal.block, external.block);
+      return false;
     }
-    case ImageType::IMAGE_TYPE_GRAYSCALE: {
-      uint8_t gray = static_cast<uint8_t>(0.2125 * color.r + 0.7154 * color.g + 0.0721 * color.b);
-      if (this->transparency_ == image::TRANSPARENCY_CHROMA_KEY) {
-        if (gray == 1) {
-          gray = 0;
-        }
-        if (color.w < 0x80) {
-          gray = 1;
+    plan.memory += needs[i].size;
+  }
+  return true;
+}
+
+bool LocalImage::plan_load_() {
+  LOCAL_IMAGE_TRACE_SCOPE("plan");
+  this->plan_ = LoadPlan{};
+  this->plan_.read_ahead = this->read_ahead_enabled_;
+
+  RAMAllocator<uint8_t> allocator(RAMAllocator<uint8_t>::ALLOC_INTERNAL | RAMAllocator<uint8_t>::ALLOC_EXTERNAL);
+  int width = 0;
+  int height = 0;
+  bool known = probe_image_size(this->format_, this->source_buffer_, this->source_len_, width, height);
+  if (allocator.get_max_free_block_size() == 0 || (!known && this->is_auto_resize_())) {
+    // Nothing to plan with, load as configured.
+    ESP_LOGV(TAG, "Load plan: as configured (%s)", known ? "free memory unknown" : "image size unknown");
+    return true;
+  }
+
+  // From fastest to cheapest: as configured, without read ahead, then JPEG decoded at a smaller scale.
+  const bool can_prescale = this->format_ == ImageFormat::JPEG && this->is_auto_resize_();
+  for (uint8_t scale = 1; scale <= 8; scale *= 2) {
+    if (scale > 1 && !can_prescale)
+      break;
+    for (int read_ahead = this->read_ahead_enabled_ ? 1 : 0; read_ahead >= 0; read_ahead--) {
+      LoadPlan plan{read_ahead != 0, scale, 0};
+      if (this->plan_fits_(plan, width, height)) {
+        this->plan_ = plan;
+        if (plan.read_ahead != this->read_ahead_enabled_ || plan.jpeg_scale != 1) {
+          ESP_LOGW(TAG, "Low memory, loading %s with read ahead %s, scale 1/%u", this->path_.c_str(),
+                   YESNO(plan.read_ahead), plan.jpeg_scale);
         }
-      } else if (this->transparency_ == image::TRANSPARENCY_ALPHA_CHANNEL) {
-        if (color.w != 0xFF)
-          gray = color.w;
+        ESP_LOGD(TAG, "Load plan: %dx%d, read ahead %s, scale 1/%u, %zu bytes to allocate", width, height,
+                 YESNO(plan.read_ahead), plan.jpeg_scale, plan.memory);
+        return true;
       }
-      this->buffer_[pos] = gray;
-      break;
     }
-    case ImageType::IMAGE_TYPE_RGB565: {
-      this->map_chroma_key(color);
-      uint16_t col565 = display::ColorUtil::color_to_565(color);
-      this->buffer_[pos + 0] = static_cast<uint8_t>((col565 >> 8) & 0xFF);
-      this->buffer_[pos + 1] = static_cast<uint8_t>(col565 & 0xFF);
-      if (this->transparency_ == image::TRANSPARENCY_ALPHA_CHANNEL) {
-        this->buffer_[pos + 2] = color.w;
-      }
-      break;
+  }
+  ESP_LOGE(TAG, "Not enough memory to load %s (%dx%d) with any strategy. Biggest block in heap: %zu Bytes",
+           this->path_.c_str(), width, height, allocator.get_max_free_block_size());
+  return false;
+}
+
+std::unique_ptr<ImageDecoder> LocalImage::create_decoder_(ImageFormat format) {
+#ifdef USE_ONLINE_IMAGE_BMP_SUPPORT
+  if (format == ImageFormat::BMP) {
+    ESP_LOGD(TAG, "Allocating BMP decoder");
+    return make_unique<BmpDecoder>(this);
+  }
+#endif  // ONLINE_IMAGE_BMP_SUPPORT
+#ifdef USE_ONLINE_IMAGE_JPEG_SUPPORT
+  if (format == ImageFormat::JPEG) {
+    ESP_LOGD(TAG, "Allocating JPEG decoder");
+    return esphome::make_unique<JpegDecoder>(this);
+  }
+#endif  // USE_ONLINE_IMAGE_JPEG_SUPPORT
+#ifdef USE_ONLINE_IMAGE_PNG_SUPPORT
+  if (format == ImageFormat::PNG) {
+    ESP_LOGD(TAG, "Allocating PNG decoder");
+    return make_unique<PngDecoder>(this);
+  }
+#endif  // ONLINE_IMAGE_PNG_SUPPORT
+#ifdef USE_LOCAL_IMAGE_QOI_SUPPORT
+  if (format == ImageFormat::QOI) {
+    ESP_LOGD(TAG, "Allocating QOI decoder");
+    return make_unique<QoiDecoder>(this);
+  }
+#endif  // USE_LOCAL_IMAGE_QOI_SUPPORT
+  return nullptr;
+}
+
+bool LocalImage::start_load_(const std::string &path) {
+  LOCAL_IMAGE_TRACE_SCOPE("start_load");
+  this->last_error_ = ErrorCode::OK;
+  this->metrics_ = LoadMetrics{};
+  this->load_start_ = micros();
+
+  //
+  //  If free memory from previous loading. if any.
+  //
+  if (this->loading_ || this->checking_) {
+    this->abort_load_();
+  }
+  this->path_ = path;
+  this->direct_ = this->direct_pending_;
+  this->direct_pending_ = DirectTarget{};
+  if (this->is_direct_()) {
+    // Rows go to the display, the previous image would not match the buffer size anymore.
+    this->free_image_buffer_();
+  }
+
+  const bool watch = this->watch_request_;
+  this->watch_request_ = false;
+  if (this->fingerprint_mode_ != FINGERPRINT_NONE && this->has_image_() && this->loaded_fingerprint_.valid &&
+      this->loaded_path_ == path) {
+    // A watch keeps the image while a file can not be read, a requested load reports the error.
+    if (!this->sizes_changed_(!watch)) {
+      if (this->fingerprint_mode_ == FINGERPRINT_SIZE) {
+        ESP_LOGV(TAG, "File %s unchanged, skip loading", path.c_str());
+        return false;
+      }
+      if (this->start_check_()) {
+        // The hashes are compared chunk by chunk from process_load_(), which loads the image if they differ.
+        return true;
+      }
+      if (watch) {
+        return false;
+      }
+    }
+    this->forget_cached_files_();
+  }
+  return this->begin_load_();
+}
+
+bool LocalImage::begin_load_() {
+  ESP_LOGD(TAG, "Loading image from file : %s", this->path_.c_str());
+
+  this->file_size_ = this->provider_->get_size(this->path_);
+  if ((this->file_size_ == 0) || (this->provider_->error() != 0)) {
+    ESP_LOGE(TAG, "File %s check error: %s", path_.c_str(), this->provider_->error_str());
+    this->last_error_ = ErrorCode::FILE_NOT_NOTFOUND;
+    return false;
+  }
+
+  //
+  //    Get Memory for read file. Decoders which need the whole file at once resize it in prepare().
+  //
+  if (this->resize_source_buffer(std::min(this->file_size_, this->read_chunk_size_)) == 0) {
+    return false;
+  }
+
+  //
+  //   Open file
+  //
+  ESP_LOGD(TAG, "Read file: %s. Size=%zu", path_.c_str(), this->file_size_);
+  if (!this->open_source_(this->path_)) {
+    ESP_LOGE(TAG, "Error open file %s : %s ", path_.c_str(), this->provider_->error_str());
+    this->last_error_ = ErrorCode::FILE_NOT_NOTFOUND;
+    this->abort_load_();
+    return false;
+  }
+  this->file_offset_ = 0;
+  this->source_len_ = 0;
+  this->load_hash_ = FNV1A_OFFSET;
+  this->reset_changed_area_();
+  if (this->load_stats_ != nullptr) {
+    this->load_stats_->reset();
+  }
+  this->loaded_fingerprint_.valid = false;
+  this->progress_y1_ = INT16_MAX;
+  this->progress_y2_ = -1;
+  this->progress_reported_ = -1;
+  //
+  //   Read the header and choose how to load with the memory available
+  //
+  if (!this->read_chunk_()) {
+    return false;
+  }
+  if (this->is_direct_() && this->format_ == ImageFormat::PNG &&
+      is_interlaced_png(this->source_buffer_, this->source_len_)) {
+    ESP_LOGE(TAG, "Interlaced PNG images can not be drawn directly");
+    this->last_error_ = ErrorCode::DECODER_NOT_PREPARE;
+    this->abort_load_();
+    return false;
+  }
+  if (!this->plan_load_()) {
+    this->last_error_ = ErrorCode::NO_MEM;
+    this->abort_load_();
+    return false;
+  }
+
+  //
+  //  Prepare Decoder
+  //
+  if (this->decoder_ != nullptr) {
+    // Kept from the previous load, see set_keep_decoder().
+    ESP_LOGV(TAG, "Reusing decoder");
+    this->decoder_->reset();
+  } else {
+    this->decoder_ = this->create_decoder_(this->format_);
+  }
+
+  if (!this->decoder_) {
+    ESP_LOGE(TAG, "Could not instantiate decoder. Image format unsupported: %d", this->format_);
+    this->last_error_ = ErrorCode::DECODER_NOT_INIT;
+    this->abort_load_();
+    return false;
+  }
+
+#ifdef USE_ONLINE_IMAGE_JPEG_SUPPORT
+  if (this->format_ == ImageFormat::JPEG) {
+    static_cast<JpegDecoder *>(this->decoder_.get())->set_scale(this->plan_.jpeg_scale);
+  }
+#endif  // USE_ONLINE_IMAGE_JPEG_SUPPORT
+  int prepared;
+  {
+    LOCAL_IMAGE_TRACE_SCOPE("decoder prepare");
+    prepared = this->decoder_->prepare(this->file_size_);
+  }
+  if (prepared < 0) {
+    ESP_LOGE(TAG, "Error when prepare decoder.");
+    this->last_error_ = ErrorCode::DECODER_NOT_PREPARE;
+    this->abort_load_();
+    return false;
+  }
+  this->rewind_cached_();
+
+#ifdef USE_LOCAL_IMAGE_READ_AHEAD
+  if (this->plan_.read_ahead && this->file_ != nullptr && this->file_offset_ < this->file_size_) {
+    this->read_ahead_active_ =
+        this->read_ahead_.start(this->file_, this->file_size_ - this->file_offset_, this->read_chunk_size_);
+    if (!this->read_ahead_active_) {
+      ESP_LOGW(TAG, "Read ahead not available, reading synchronously");
+    }
+  }
+#endif  // USE_LOCAL_IMAGE_READ_AHEAD
+  this->loading_ = true;
+  return true;
+}
+
+bool LocalImage::read_chunk_() {
+  size_t want = std::min(this->source_size_ - this->source_len_, this->file_size_ - this->file_offset_);
+  want = std::min(want, this->read_chunk_size_);
+  if (want == 0) {
+    return true;
+  }
+  LOCAL_IMAGE_TRACE_SCOPE("read");
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  if (this->cached_ != nullptr) {
+    memcpy(this->source_buffer_ + this->source_len_, this->cached_ + this->file_offset_, want);
+    this->update_fingerprint_(this->source_buffer_ + this->source_len_, want);
+    this->source_len_ += want;
+    this->file_offset_ += want;
+    return true;
+  }
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
+  uint32_t start = micros();
+  size_t read_bytes = this->file_->read(this->source_buffer_ + this->source_len_, want);
+  this->metrics_.read_us += micros() - start;
+  if (this->file_->error() != 0) {
+    ESP_LOGE(TAG, "Error reading file %s : %s", path_.c_str(), this->provider_->error_str());
+    this->last_error_ = ErrorCode::FILE_NOT_NOTFOUND;
+    this->abort_load_();
+    return false;
+  }
+  if (read_bytes == 0) {
+    ESP_LOGW(TAG, "Expect %zu bytes, but read %zu bytes.", this->file_size_, this->file_offset_);
+    this->file_size_ = this->file_offset_;
+  }
+  this->update_fingerprint_(this->source_buffer_ + this->source_len_, read_bytes);
+  this->fill_cache_(this->source_buffer_ + this->source_len_, read_bytes);
+  this->source_len_ += read_bytes;
+  this->file_offset_ += read_bytes;
+  this->metrics_.bytes_read += read_bytes;
+  return true;
+}
+
+bool LocalImage::process_load_() {
+  if (this->checking_) {
+    return this->process_check_();
+  }
+  if (!this->loading_) {
+    return true;
+  }
+
+  //
+  //   Get next chunk
+  //
+  uint8_t *data = this->source_buffer_;
+  size_t len = 0;
+  bool from_source = true;
+  bool from_cache = false;
+  size_t cache_left = 0;
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  if (this->cached_ != nullptr && this->source_len_ == 0) {
+    // Decode in place from the cached file, the decoders only read their input.
+    cache_left = this->file_size_ - this->file_offset_;
+    data = const_cast<uint8_t *>(this->cached_) + this->file_offset_;
+    len = std::min(cache_left, this->cache_window_);
+    from_source = false;
+    from_cache = true;
+  } else
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
+#ifdef USE_LOCAL_IMAGE_READ_AHEAD
+  if (this->read_ahead_active_ && this->source_len_ == this->source_size_) {
+    // The source buffer is full (e.g. the header block), decode it before taking the next block.
+  } else if (this->read_ahead_active_) {
+    uint8_t *block;
+    size_t block_len;
+    uint32_t wait_start = micros();
+    bool ready;
+    {
+      LOCAL_IMAGE_TRACE_SCOPE("read ahead wait");
+      ready = this->read_ahead_.acquire(block, block_len, 1);
+    }
+    this->metrics_.wait_us += micros() - wait_start;
+    if (this->read_ahead_.has_error()) {
+      ESP_LOGE(TAG, "Error reading file %s : %s", path_.c_str(), this->provider_->error_str());
+      this->last_error_ = ErrorCode::FILE_NOT_NOTFOUND;
+      this->abort_load_();
+      return true;
+    }
+    if (ready) {
+      this->update_fingerprint_(block, block_len);
+      this->fill_cache_(block, block_len);
+      if (this->source_len_ == 0 && this->source_size_ < this->file_size_) {
+        // Streaming decoder and nothing left over from the previous block: decode straight from the read buffer.
+        data = block;
+        len = block_len;
+        from_source = false;
+      } else {
+        if (this->source_len_ + block_len > this->source_size_ &&
+            this->resize_source_buffer(this->source_len_ + block_len) == 0) {
+          this->abort_load_();
+          return true;
+        }
+        memcpy(this->source_buffer_ + this->source_len_, block, block_len);
+        this->source_len_ += block_len;
+        this->read_ahead_.release();
+      }
+      this->file_offset_ += block_len;
+    } else if (this->read_ahead_.is_done()) {
+      if (this->file_offset_ < this->file_size_) {
+        ESP_LOGW(TAG, "Expect %zu bytes, but read %zu bytes.", this->file_size_, this->file_offset_);
+        this->file_size_ = this->file_offset_;
+      }
+    } else {
+      // The reader is still busy with the next block.
+      return false;
+    }
+  } else
+#endif  // USE_LOCAL_IMAGE_READ_AHEAD
+  {
+    if (!this->read_chunk_()) {
+      return true;
+    }
+  }
+  if (from_source) {
+    data = this->source_buffer_;
+    len = this->source_len_;
+  }
+
+  //
+  //   Decode what is available
+  //
+  uint32_t decode_start = micros();
+  auto fed = this->active_decoder_()->decode(data, len);
+  this->metrics_.decode_us += micros() - decode_start;
+  if (fed < 0 && this->overlay_index_ >= 0) {
+    ESP_LOGW(TAG, "Error decoding overlay %s (%d), left out", this->overlays_[this->overlay_index_].path.c_str(), fed);
+    return this->finish_layer_();
+  }
+  if (fed < 0) {
+    ESP_LOGE(TAG, "Error decoding image %d", fed);
+    this->last_error_ = ErrorCode::DECODER_PROC_ERR;
+    this->abort_load_();
+    return true;
+  }
+  if (from_cache) {
+    this->update_fingerprint_(data, fed);
+    this->file_offset_ += fed;
+  } else if (from_source) {
+    if (fed > 0) {
+      this->source_len_ -= fed;
+      memmove(this->source_buffer_, this->source_buffer_ + fed, this->source_len_);
+    }
+  } else {
+#ifdef USE_LOCAL_IMAGE_READ_AHEAD
+    // Keep what the decoder did not consume, the read buffer goes back to the reader.
+    size_t left = len - fed;
+    if (left > this->source_size_ && this->resize_source_buffer(left) == 0) {
+      this->abort_load_();
+      return true;
+    }
+    memcpy(this->source_buffer_, data + fed, left);
+    this->source_len_ = left;
+    this->read_ahead_.release();
+#endif  // USE_LOCAL_IMAGE_READ_AHEAD
+  }
+
+  // From the cache the rest of the file was passed to the decoder once the window reaches the end.
+  bool eof = this->file_offset_ >= this->file_size_ || (from_cache && len == cache_left);
+  size_t pending = from_cache ? cache_left - fed : this->source_len_;
+  if (this->active_decoder_()->is_finished() || (eof && (fed == 0 || pending == 0))) {
+    if (from_cache) {
+      // The fingerprint covers the whole file, also what the decoder left unread.
+      this->update_fingerprint_(this->cached_ + this->file_offset_, this->file_size_ - this->file_offset_);
+      this->file_offset_ = this->file_size_;
+    }
+    return this->finish_layer_();
+  }
+  if (from_cache && fed == 0) {
+    // The decoder needs more data at once, e.g. JPEG the whole file.
+    this->cache_window_ = std::min(this->cache_window_ * 2, cache_left);
+    return false;
+  }
+  if (fed == 0 && this->source_len_ == this->source_size_) {
+    ESP_LOGE(TAG, "Decoder made no progress with a full buffer of %zu bytes", this->source_size_);
+    this->last_error_ = ErrorCode::DECODER_PROC_ERR;
+    this->abort_load_();
+    return true;
+  }
+  return false;
+}
+
+void LocalImage::add_overlay(const std::string &path, int x, int y, ImageFormat format) {
+  this->overlays_.push_back(Overlay{path, x, y, format, FileFingerprint{}});
+  this->loaded_fingerprint_.valid = false;
+}
+
+bool LocalImage::finish_layer_() {
+  this->close_source_();
+  if (this->overlay_index_ >= 0) {
+    this->blend_band_();
+    Overlay &overlay = this->overlays_[this->overlay_index_];
+    overlay.fingerprint.size = this->file_size_;
+    overlay.fingerprint.hash = this->fingerprint_mode_ == FINGERPRINT_SIZE ? 0 : this->load_hash_;
+    overlay.fingerprint.valid = this->fingerprint_mode_ != FINGERPRINT_NONE;
+  } else {
+    this->image_file_size_ = this->file_size_;
+    this->image_hash_ = this->load_hash_;
+  }
+  while (!this->is_direct_() && this->buffer_ != nullptr &&
+         this->overlay_index_ + 1 < static_cast<int>(this->overlays_.size())) {
+    this->overlay_index_++;
+    Overlay &overlay = this->overlays_[this->overlay_index_];
+    overlay.fingerprint.valid = false;
+    if (this->start_overlay_(overlay.path, overlay.format)) {
+      return false;
+    }
+    if (!this->loading_) {
+      // Aborted on a read error.
+      return true;
+    }
+    ESP_LOGW(TAG, "Overlay %s left out", overlay.path.c_str());
+  }
+  this->overlay_index_ = -1;
+  this->file_size_ = this->image_file_size_;
+  this->load_hash_ = this->image_hash_;
+  this->finish_load_();
+  return true;
+}
+
+bool LocalImage::start_overlay_(const std::string &path, ImageFormat format) {
+  LOCAL_IMAGE_TRACE_SCOPE("start overlay");
+  this->close_source_();
+  this->file_size_ = this->provider_->get_size(path);
+  if (this->file_size_ == 0 || this->provider_->error() != 0) {
+    ESP_LOGW(TAG, "Overlay %s check error: %s", path.c_str(), this->provider_->error_str());
+    return false;
+  }
+  if (!this->open_source_(path)) {
+    ESP_LOGW(TAG, "Error open overlay %s : %s", path.c_str(), this->provider_->error_str());
+    return false;
+  }
+  this->file_offset_ = 0;
+  this->source_len_ = 0;
+  this->load_hash_ = FNV1A_OFFSET;
+  this->overlay_width_ = 0;
+  this->overlay_height_ = 0;
+  this->band_index_ = -1;
+
+  if (this->overlay_decoder_ != nullptr && this->overlay_format_ == format) {
+    this->overlay_decoder_->reset();
+  } else {
+    this->overlay_decoder_ = this->create_decoder_(format);
+    this->overlay_format_ = format;
+  }
+  if (this->overlay_decoder_ == nullptr) {
+    ESP_LOGW(TAG, "Overlay format unsupported: %d", format);
+    return false;
+  }
+#ifdef USE_ONLINE_IMAGE_JPEG_SUPPORT
+  if (format == ImageFormat::JPEG) {
+    static_cast<JpegDecoder *>(this->overlay_decoder_.get())->set_scale(1);
+  }
+#endif  // USE_ONLINE_IMAGE_JPEG_SUPPORT
+  if (this->overlay_decoder_->prepare(this->file_size_) < 0) {
+    return false;
+  }
+  if (format == ImageFormat::PNG) {
+    if (!this->read_chunk_()) {
+      return false;
+    }
+    if (is_interlaced_png(this->source_buffer_, this->source_len_)) {
+      // Interlaced passes would blend rows of the overlay more than once.
+      ESP_LOGW(TAG, "Interlaced PNG overlays are not supported");
+      return false;
+    }
+    this->rewind_cached_();
+  }
+  return true;
+}
+
+void LocalImage::draw_overlay_(int x, int y, int w, int h, Color color) {
+  const int x2 = std::min(x + w, this->overlay_width_);
+  const int y2 = std::min(y + h, this->overlay_height_);
+  x = std::max(x, 0);
+  for (int j = std::max(y, 0); j < y2; j++) {
+    if (j / DIRECT_BAND_ROWS != this->band_index_) {
+      this->select_overlay_band_(j / DIRECT_BAND_ROWS);
+    }
+    if (this->band_ == nullptr) {
+      return;
+    }
+    uint8_t *pos = this->band_ + ((j - this->band_area_.y) * this->band_area_.w + x) * 4;
+    for (int i = x; i < x2; i++) {
+      *pos++ = color.r;
+      *pos++ = color.g;
+      *pos++ = color.b;
+      *pos++ = color.w;
+    }
+  }
+}
+
+void LocalImage::select_overlay_band_(int index) {
+  this->blend_band_();
+  this->band_index_ = index;
+  const int y = index * DIRECT_BAND_ROWS;
+  this->band_area_ = display::Rect(0, y, this->overlay_width_, std::min(DIRECT_BAND_ROWS, this->overlay_height_ - y));
+  size_t size = static_cast<size_t>(this->overlay_width_) * DIRECT_BAND_ROWS * 4;
+  if (size > this->band_size_) {
+    this->free_band_();
+    this->band_index_ = index;
+    this->band_ = this->allocator_.allocate(size);
+    if (this->band_ == nullptr) {
+      ESP_LOGW(TAG, "allocation of %zu bytes for the overlay band failed", size);
+      return;
+    }
+    this->band_size_ = size;
+  }
+  // Pixels the decoder does not draw stay transparent.
+  memset(this->band_, 0, size);
+}
+
+void LocalImage::blend_band_() {
+  if (this->band_ == nullptr || this->band_index_ < 0) {
+    return;
+  }
+  LOCAL_IMAGE_TRACE_SCOPE("blend band");
+  const Overlay &overlay = this->overlays_[this->overlay_index_];
+  const int x1 = std::max(0, overlay.x);
+  const int x2 = std::min(this->buffer_width_, overlay.x + this->band_area_.w);
+  for (int row = 0; row < this->band_area_.h && x1 < x2; row++) {
+    const int y = overlay.y + this->band_area_.y + row;
+    if (y < 0 || y >= this->buffer_height_)
+      continue;
+    this->blend_row_(x1, y, this->band_ + (row * this->band_area_.w + x1 - overlay.x) * 4, x2 - x1);
+  }
+  this->band_index_ = -1;
+}
+
+void LocalImage::blend_row_(int x, int y, const uint8_t *rgba, int count) {
+  // Only the span between the first and the last visible pixel is touched.
+  int first = 0;
+  while (first < count && rgba[first * 4 + 3] == 0)
+    first++;
+  if (first == count)
+    return;
+  int last = count - 1;
+  while (rgba[last * 4 + 3] == 0)
+    last--;
+
+  const bool plain = this->packing_ == PACKING_NONE && this->mask_ == nullptr &&
+                     this->transparency_ == image::TRANSPARENCY_OPAQUE && this->dither_ == DITHER_NONE;
+  uint8_t *row = this->buffer_ + y * this->get_stride_();
+  if (plain && this->type_ == ImageType::IMAGE_TYPE_RGB565) {
+    uint8_t *dst = row + (x + first) * 2;
+    for (int i = first; i <= last; i++, dst += 2) {
+      const uint8_t *src = rgba + i * 4;
+      if (src[3] == 0)
+        continue;
+      Color color(src[0], src[1], src[2]);
+      if (src[3] != 0xFF) {
+        uint16_t rgb565 = RGB565_BIG_ENDIAN ? encode_uint16(dst[0], dst[1]) : encode_uint16(dst[1], dst[0]);
+        uint8_t r = rgb565 >> 11;
+        uint8_t g = (rgb565 >> 5) & 0x3F;
+        uint8_t b = rgb565 & 0x1F;
+        color = blend_color(color, Color((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)), src[3]);
+      }
+      uint16_t rgb565 = display::ColorUtil::color_to_565(color);
+      dst[RGB565_BIG_ENDIAN ? 0 : 1] = rgb565 >> 8;
+      dst[RGB565_BIG_ENDIAN ? 1 : 0] = rgb565 & 0xFF;
+    }
+  } else if (plain && this->type_ == ImageType::IMAGE_TYPE_RGB) {
+    uint8_t *dst = row + (x + first) * 3;
+    for (int i = first; i <= last; i++, dst += 3) {
+      const uint8_t *src = rgba + i * 4;
+      const uint8_t alpha = src[3];
+      if (alpha == 0xFF) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+      } else if (alpha != 0) {
+        dst[0] = blend_channel(src[0], dst[0], alpha);
+        dst[1] = blend_channel(src[1], dst[1], alpha);
+        dst[2] = blend_channel(src[2], dst[2], alpha);
+      }
+    }
+  } else {
+    // Other layouts go through the pixel conversion of the decoder path.
+    const uint8_t *mask = this->get_mask_row_(y);
+    for (int i = first; i <= last; i++) {
+      const uint8_t *src = rgba + i * 4;
+      if (src[3] == 0)
+        continue;
+      Color dst = this->get_row_pixel_(row, x + i, Color(255, 255, 255), Color(0, 0, 0));
+      if (mask != nullptr && !(mask[(x + i) / 8] & (0x80 >> ((x + i) & 7))))
+        dst.w = 0;
+      this->store_pixel_(x + i, y, blend_color(Color(src[0], src[1], src[2]), dst, src[3]));
+    }
+    return;
+  }
+  for (int px = x + first; px < x + last; px += 1 << DIRTY_TILE_SHIFT) {
+    this->mark_changed_(px, y);
+  }
+  this->mark_changed_(x + last, y);
+}
+
+void LocalImage::finish_load_() {
+  if (this->is_direct_()) {
+    // The last band is still waiting for the display.
+    this->flush_band_();
+    ESP_LOGD(TAG, "Image drawn directly, read %zu bytes, width/height = %d/%d", this->file_offset_,
+             this->buffer_width_, this->buffer_height_);
+    this->dirty_rects_.clear();
+    this->image_loaded_ = true;
+    this->abort_load_();
+    this->metrics_.total_us = micros() - this->load_start_;
+    return;
+  }
+  if (this->buffer_ == nullptr) {
+    ESP_LOGE(TAG, "Decoder finished without producing an image");
+    this->last_error_ = ErrorCode::DECODER_PROC_ERR;
+    this->abort_load_();
+    return;
+  }
+  //
+  // Pass prepared patas to parent Image class
+  //
+  // The base Image class can not read packed pixels, nor the mask.
+  this->data_start_ = this->packing_ == PACKING_NONE && this->mask_ == nullptr ? this->buffer_ : nullptr;
+  this->width_ = buffer_width_;
+  this->height_ = buffer_height_;
+  if (this->compression_ == COMPRESSION_RLE) {
+    LOCAL_IMAGE_TRACE_SCOPE("compress");
+    this->compress_image_buffer_();
+  }
+  {
+    LOCAL_IMAGE_TRACE_SCOPE("dirty rects");
+    this->build_dirty_rects_();
+  }
+  this->buffer_complete_ = true;
+  this->image_loaded_ = true;
+  if (this->load_stats_ != nullptr) {
+    std::swap(this->stats_, this->load_stats_);
+    this->stats_valid_ = true;
+  }
+  if (this->fingerprint_mode_ != FINGERPRINT_NONE) {
+    this->loaded_fingerprint_.size = this->file_size_;
+    this->loaded_fingerprint_.hash = this->fingerprint_mode_ == FINGERPRINT_SIZE ? 0 : this->load_hash_;
+    this->loaded_fingerprint_.valid = true;
+    this->loaded_path_ = this->path_;
+  }
+  ESP_LOGD(TAG, "Image fully loaded, read %zu bytes, width/height = %d/%d", this->file_offset_, this->width_,
+           this->height_);
+  this->abort_load_();
+
+  this->metrics_.total_us = micros() - this->load_start_;
+#if defined(USE_LOCAL_IMAGE_TRACE) && defined(USE_HOST)
+  global_trace_buffer.dump();
+#endif
+  ESP_LOGD(TAG, "Load metrics: %zu bytes read in %.1f ms (%.2f MB/s), waited %.1f ms, decoded in %.1f ms, total %.1f ms",
+           this->metrics_.bytes_read, this->metrics_.read_us / 1000.0f, this->metrics_.read_mbps(),
+           this->metrics_.wait_us / 1000.0f, this->metrics_.decode_us / 1000.0f, this->metrics_.total_us / 1000.0f);
+}
+
+bool LocalImage::open_source_(const std::string &path) {
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  this->cached_ = global_file_cache.acquire(path, this->file_size_);
+  if (this->cached_ != nullptr) {
+    ESP_LOGD(TAG, "Reading %s from the file cache", path.c_str());
+    this->cache_window_ = this->read_chunk_size_;
+    return true;
+  }
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
+  {
+    LOCAL_IMAGE_TRACE_SCOPE("open");
+    this->file_ = this->provider_->open_file(path, storage::OPEN_READ);
+  }
+  if (this->file_ == nullptr || this->provider_->error() != 0) {
+    return false;
+  }
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  this->cache_fill_ = global_file_cache.reserve(path, this->file_size_);
+  this->cache_fill_size_ = this->file_size_;
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
+  return true;
+}
+
+bool LocalImage::is_cached_() const {
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  return this->cached_ != nullptr;
+#else
+  return false;
+#endif
+}
+
+void LocalImage::rewind_cached_() {
+  if (this->is_cached_()) {
+    this->file_offset_ = 0;
+    this->source_len_ = 0;
+    this->load_hash_ = FNV1A_OFFSET;
+  }
+}
+
+void LocalImage::fill_cache_(const uint8_t *data, size_t len) {
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  if (this->cache_fill_ != nullptr && this->file_offset_ + len <= this->cache_fill_size_) {
+    memcpy(this->cache_fill_ + this->file_offset_, data, len);
+  }
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
+}
+
+void LocalImage::close_source_() {
+#ifdef USE_LOCAL_IMAGE_READ_AHEAD
+  if (this->read_ahead_active_) {
+    // Join the reader before the file is closed.
+    // Added to the header block read before the reader started.
+    this->metrics_.bytes_read += this->read_ahead_.bytes_read();
+    this->metrics_.read_us += this->read_ahead_.read_time_us();
+    this->read_ahead_.stop();
+    this->read_ahead_active_ = false;
+  }
+#endif  // USE_LOCAL_IMAGE_READ_AHEAD
+  if (this->file_ != nullptr) {
+    delete this->file_;
+    this->file_ = nullptr;
+  }
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  if (this->cached_ != nullptr) {
+    global_file_cache.release(this->cached_, true);
+    this->cached_ = nullptr;
+  }
+  if (this->cache_fill_ != nullptr) {
+    // Only a file read to the end is kept.
+    global_file_cache.release(this->cache_fill_, this->file_offset_ >= this->cache_fill_size_);
+    this->cache_fill_ = nullptr;
+  }
+#endif  // USE_LOCAL_IMAGE_FILE_CACHE
+}
+
+void LocalImage::abort_load_() {
+  this->close_source_();
+  this->free_band_();
+  this->overlay_index_ = -1;
+  if (this->is_direct_()) {
+    this->direct_ = DirectTarget{};
+    // Nothing is stored, the size only applied to the bands.
+    this->buffer_width_ = 0;
+    this->buffer_height_ = 0;
+  }
+  this->loading_ = false;
+  this->checking_ = false;
+  this->source_len_ = 0;
+  this->release_decoder_();
+}
+
+void LocalImage::release_decoder_() {
+  if (this->keep_decoder_ && this->decoder_ != nullptr) {
+    // Decoder and source buffer stay allocated for the next load.
+    return;
+  }
+  this->free_source_buffer_();
+}
+
+void LocalImage::release() {
+  if (this->scheduler_ != nullptr) {
+    this->scheduler_->cancel(this);
+  } else if (this->loading_ || this->checking_) {
+    this->abort_load_();
+  }
+  this->free_source_buffer_();
+  this->free_image_buffer_();
+}
+
+size_t LocalImage::resize_source_buffer(size_t size) {
+  if (this->source_buffer_ != nullptr && this->source_size_ >= size) {
+    return this->source_size_;
+  }
+  LOCAL_IMAGE_TRACE_SCOPE("alloc source buffer");
+  uint8_t *buffer;
+  if (this->source_buffer_ == nullptr) {
+    buffer = this->allocator_.allocate(size);
+  } else {
+    buffer = this->allocator_.reallocate(this->source_buffer_, size);
+  }
+  if (buffer == nullptr) {
+    ESP_LOGE(TAG, "No memory. (Size: %zu)", size);
+    this->last_error_ = ErrorCode::NO_MEM;
+    return 0;
+  }
+  this->source_buffer_ = buffer;
+  this->source_size_ = size;
+  return size;
+}
+
+void LocalImage::compress_image_buffer_() {
+  size_t stride = this->get_stride_();
+  size_t unit = this->get_bpp() % 8 == 0 ? this->get_bpp() / 8 : 1;
+
+  // Two rows, the second one for the next row of a box filtered draw_scaled().
+  if (this->line_buffer_size_ < 2 * stride) {
+    if (this->line_buffer_ != nullptr) {
+      this->allocator_.deallocate(this->line_buffer_, this->line_buffer_size_);
+    }
+    this->line_buffer_ = this->allocator_.allocate(2 * stride);
+    this->line_buffer_size_ = this->line_buffer_ == nullptr ? 0 : 2 * stride;
+    if (this->line_buffer_ == nullptr) {
+      ESP_LOGW(TAG, "Could not allocate line buffer, keeping image uncompressed");
+      this->previous_.clear();
+      return;
+    }
+  }
+
+  if (!this->previous_.empty() && this->previous_.stride() == stride &&
+      this->previous_.rows() == this->buffer_height_) {
+    // The buffer was freshly allocated, so the changes are found by comparing with the previous image.
+    this->reset_changed_area_();
+    for (int y = 0; y < this->buffer_height_; y++) {
+      this->previous_.decode_row(y, this->line_buffer_);
+      this->diff_row_(y, this->line_buffer_);
+    }
+  }
+  this->previous_.clear();
+
+  if (!this->compressed_.encode(this->buffer_, stride, this->buffer_height_, unit)) {
+    ESP_LOGW(TAG, "Could not compress image, keeping it uncompressed");
+    return;
+  }
+
+  ESP_LOGD(TAG, "Image compressed from %zu to %zu bytes", (size_t) this->get_buffer_size_(), this->compressed_.size());
+  this->allocator_.deallocate(this->buffer_, this->get_buffer_size_());
+  this->buffer_ = nullptr;
+  // The base Image class can not read compressed data.
+  this->data_start_ = nullptr;
+}
+
+void LocalImage::diff_row_(int y, const uint8_t *old_row) {
+  const uint8_t *row = this->buffer_ + y * this->get_stride_();
+  const size_t stride = this->get_stride_();
+  if (memcmp(row, old_row, stride) == 0) {
+    return;
+  }
+  if (this->get_bpp() < 8) {
+    for (int x = 0; x < this->buffer_width_; x++) {
+      if (this->get_packed_value_(row, x) != this->get_packed_value_(old_row, x)) {
+        this->mark_changed_(x, y);
+      }
+    }
+    return;
+  }
+  const size_t unit = this->get_bpp() / 8;
+  for (int x = 0; x < this->buffer_width_; x++) {
+    if (memcmp(row + x * unit, old_row + x * unit, unit) != 0) {
+      this->mark_changed_(x, y);
+    }
+  }
+}
+
+int LocalImage::get_decode_threads_() const {
+  // Workers must write separate rows of the buffer and of the dirty tiles, and nothing else of the load state.
+  if (this->decode_threads_ <= 1 || this->rotation_ != 0 || this->mirror_y_ || this->progressive_ ||
+      this->is_direct_() || this->overlay_index_ >= 0) {
+    return 1;
+  }
+  return this->decode_threads_;
+}
+
+void LocalImage::begin_parallel_decode_(int band_rows, int bands) {
+  this->parallel_decode_ = true;
+  if (this->load_stats_ != nullptr) {
+    this->band_stats_.assign(bands, ImageStats());
+    this->band_stats_rows_ = band_rows;
+  }
+}
+
+void LocalImage::end_parallel_decode_() {
+  this->parallel_decode_ = false;
+  for (auto &stats : this->band_stats_) {
+    this->load_stats_->merge(stats);
+  }
+  this->band_stats_.clear();
+  this->band_stats_.shrink_to_fit();
+  const int tiles_w = this->dirty_tiles_w_;
+  const int tiles_h = tiles_w == 0 ? 0 : this->dirty_tiles_.size() / tiles_w;
+  for (int ty = 0; ty < tiles_h; ty++) {
+    for (int tx = 0; tx < tiles_w; tx++) {
+      if (this->dirty_tiles_[ty * tiles_w + tx] != TILE_DIRTY)
+        continue;
+      this->mark_changed_(tx << DIRTY_TILE_SHIFT, ty << DIRTY_TILE_SHIFT);
+      this->mark_changed_(std::min(((tx + 1) << DIRTY_TILE_SHIFT) - 1, this->buffer_width_ - 1),
+                          std::min(((ty + 1) << DIRTY_TILE_SHIFT) - 1, this->buffer_height_ - 1));
+    }
+  }
+}
+
+void LocalImage::build_dirty_rects_() {
+  this->dirty_rects_.clear();
+  if (this->changed_x2_ < this->changed_x1_) {
+    return;
+  }
+  const int tiles_w = this->dirty_tiles_w_;
+  const int tiles_h = tiles_w == 0 ? 0 : this->dirty_tiles_.size() / tiles_w;
+  const int tile = 1 << DIRTY_TILE_SHIFT;
+  auto dirty = [this, tiles_w](int tx, int ty) { return this->dirty_tiles_[ty * tiles_w + tx] == TILE_DIRTY; };
+
+  // Greedy merge: grow each uncovered dirty tile to the right, then down as long as the whole span is dirty.
+  for (int ty = 0; ty < tiles_h; ty++) {
+    for (int tx = 0; tx < tiles_w; tx++) {
+      if (!dirty(tx, ty))
+        continue;
+      int tx2 = tx;
+      while (tx2 + 1 < tiles_w && dirty(tx2 + 1, ty))
+        tx2++;
+      int ty2 = ty;
+      bool grow = true;
+      while (grow && ty2 + 1 < tiles_h) {
+        for (int i = tx; i <= tx2; i++) {
+          if (!dirty(i, ty2 + 1)) {
+            grow = false;
+            break;
+          }
+        }
+        if (grow)
+          ty2++;
+      }
+      for (int j = ty; j <= ty2; j++) {
+        for (int i = tx; i <= tx2; i++) {
+          this->dirty_tiles_[j * tiles_w + i] = TILE_COVERED;
+        }
+      }
+      int x = std::max(tx * tile, this->changed_x1_);
+      int y = std::max(ty * tile, this->changed_y1_);
+      int x2 = std::min((tx2 + 1) * tile - 1, this->changed_x2_);
+      int y2 = std::min((ty2 + 1) * tile - 1, this->changed_y2_);
+      this->dirty_rects_.push_back(display::Rect(x, y, x2 - x + 1, y2 - y + 1));
+    }
+  }
+
+  if (this->dirty_rects_.size() > MAX_DIRTY_RECTS) {
+    // Too scattered to be worth refreshing piece by piece.
+    this->dirty_rects_.clear();
+    this->dirty_rects_.push_back(this->get_changed_area());
+  }
+  ESP_LOGD(TAG, "%zu changed region(s)", this->dirty_rects_.size());
+}
+
+void LocalImage::resize_dirty_tiles_() {
+  const int tile = 1 << DIRTY_TILE_SHIFT;
+  this->dirty_tiles_w_ = (this->buffer_width_ + tile - 1) / tile;
+  this->dirty_tiles_.assign(this->dirty_tiles_w_ * ((this->buffer_height_ + tile - 1) / tile), TILE_CLEAN);
+}
+
+const uint8_t *LocalImage::get_row_(int y) {
+  if (!this->compressed_.empty()) {
+    this->compressed_.decode_row(y, this->line_buffer_);
+    return this->line_buffer_;
+  }
+  return this->buffer_ + y * this->get_stride_();
+}
+
+Color LocalImage::get_row_pixel_(const uint8_t *row, int x, Color color_on, Color color_off) const {
+  switch (this->packing_) {
+    case PACKING_GRAY2:
+    case PACKING_GRAY4: {
+      uint8_t gray = this->get_packed_value_(row, x) * 255 / ((1 << this->get_bpp()) - 1);
+      return Color(gray, gray, gray, 0xFF);
+    }
+    case PACKING_RGB332: {
+      uint8_t rgb332 = row[x];
+      return Color((rgb332 >> 5) * 255 / 7, ((rgb332 >> 2) & 0x07) * 255 / 7, (rgb332 & 0x03) * 85, 0xFF);
+    }
+    default:
+      break;
+  }
+  switch (this->type_) {
+    case ImageType::IMAGE_TYPE_BINARY: {
+      if (row[x / 8u] & (0x80 >> (x % 8u)))
+        return color_on;
+      return this->has_transparency() ? Color(0, 0, 0, 0) : color_off;
+    }
+    case ImageType::IMAGE_TYPE_GRAYSCALE: {
+      uint8_t gray = row[x];
+      if (this->transparency_ == image::TRANSPARENCY_CHROMA_KEY) {
+        return gray == 1 ? Color(0, 0, 0, 0) : Color(gray, gray, gray, 0xFF);
+      } else if (this->transparency_ == image::TRANSPARENCY_ALPHA_CHANNEL) {
+        return Color(color_on.r, color_on.g, color_on.b, gray);
+      }
+      return Color(gray, gray, gray, 0xFF);
+    }
+    case ImageType::IMAGE_TYPE_RGB565: {
+      const uint8_t *pos = row + x * this->get_bpp() / 8;
+      uint16_t rgb565 = RGB565_BIG_ENDIAN ? encode_uint16(pos[0], pos[1]) : encode_uint16(pos[1], pos[0]);
+      uint8_t r = (rgb565 & 0xF800) >> 11;
+      uint8_t g = (rgb565 & 0x07E0) >> 5;
+      uint8_t b = rgb565 & 0x001F;
+      uint8_t a = 0xFF;
+      if (this->transparency_ == image::TRANSPARENCY_ALPHA_CHANNEL) {
+        a = pos[2];
+      } else if (this->transparency_ == image::TRANSPARENCY_CHROMA_KEY && rgb565 == 0x0020) {
+        a = 0;
+      }
+      return Color((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), a);
     }
     case ImageType::IMAGE_TYPE_RGB: {
-      this->map_chroma_key(color);
-      this->buffer_[pos + 0] = color.r;
-      this->buffer_[pos + 1] = color.g;
-      this->buffer_[pos + 2] = color.b;
+      const uint8_t *pos = row + x * this->get_bpp() / 8;
+      uint8_t a = 0xFF;
       if (this->transparency_ == image::TRANSPARENCY_ALPHA_CHANNEL) {
-        this->buffer_[pos + 3] = color.w;
+        a = pos[3];
+      } else if (this->transparency_ == image::TRANSPARENCY_CHROMA_KEY && pos[0] == 0 && pos[1] == 1 && pos[2] == 0) {
+        a = 0;
+      }
+      return Color(pos[0], pos[1], pos[2], a);
+    }
+  }
+  return Color(0, 0, 0, 0);
+}
+
+void LocalImage::draw_rows_(int x, int y, display::Display *display, Color color_on, Color color_off,
+                            const display::Rect &area) {
+  int img_x0 = area.x;
+  int img_y0 = area.y;
+  int w = area.x2();
+  int h = area.y2();
+
+  auto clipping = display->get_clipping();
+  if (clipping.is_set()) {
+    if (img_x0 < clipping.x - x)
+      img_x0 = clipping.x - x;
+    if (img_y0 < clipping.y - y)
+      img_y0 = clipping.y - y;
+    if (w > clipping.x2() - x)
+      w = clipping.x2() - x;
+    if (h > clipping.y2() - y)
+      h = clipping.y2() - y;
+  }
+
+  if (img_x0 >= w)
+    return;
+  // Only the rows inside the clipping window get expanded.
+  for (int img_y = img_y0; img_y < h; img_y++) {
+    const uint8_t *mask = this->get_mask_row_(img_y);
+    if (mask != nullptr) {
+      this->draw_masked_row_(x, y, display, color_on, color_off, img_y, img_x0, w, mask);
+      continue;
+    }
+    const uint8_t *row = this->get_row_(img_y);
+    for (int img_x = img_x0; img_x < w; img_x++) {
+      Color color = this->get_row_pixel_(row, img_x, color_on, color_off);
+      if (color.w >= 0x80) {
+        display->draw_pixel_at(x + img_x, y + img_y, this->transform_color_(color));
+      }
+    }
+  }
+}
+
+void LocalImage::draw_masked_row_(int x, int y, display::Display *display, Color color_on, Color color_off,
+                                   int img_y, int img_x0, int img_x2, const uint8_t *mask) {
+  // Whole bytes of the mask cover 8 pixels: fully transparent ones are skipped without
+  // expanding the row, and a row without any opaque pixel is not expanded at all.
+  const int byte0 = img_x0 / 8;
+  const int byte2 = (img_x2 + 7) / 8;
+  int first = byte0;
+  while (first < byte2 && mask[first] == 0)
+    first++;
+  if (first == byte2)
+    return;
+
+  const uint8_t *row = this->get_row_(img_y);
+  for (int i = first; i < byte2; i++) {
+    uint8_t bits = mask[i];
+    if (bits == 0)
+      continue;
+    const int x1 = std::max(i * 8, img_x0);
+    const int x2 = std::min(i * 8 + 8, img_x2);
+    for (int img_x = x1; img_x < x2; img_x++) {
+      if (bits & (0x80 >> (img_x & 7))) {
+        display->draw_pixel_at(x + img_x, y + img_y,
+                               this->transform_color_(this->get_row_pixel_(row, img_x, color_on, color_off)));
+      }
+    }
+  }
+}
+
+void LocalImage::set_statistics(bool enable) {
+  if (enable == (this->load_stats_ != nullptr)) {
+    return;
+  }
+  if (enable) {
+    this->stats_ = make_unique<ImageStats>();
+    this->load_stats_ = make_unique<ImageStats>();
+    // Collected by the next load, even of the same file.
+    this->loaded_fingerprint_.valid = false;
+  } else {
+    this->stats_.reset();
+    this->load_stats_.reset();
+  }
+  this->stats_valid_ = false;
+}
+
+void LocalImage::set_color_transform(const ColorTransform &transform) {
+  this->color_transform_ = transform;
+  if (transform.is_identity()) {
+    this->color_lut_.clear();
+    this->color_lut_.shrink_to_fit();
+    return;
+  }
+  this->color_lut_.resize(3 * 256);
+  const uint8_t tint[3] = {transform.tint.r, transform.tint.g, transform.tint.b};
+  for (int value = 0; value < 256; value++) {
+    float adjusted = ((value - 128) * transform.contrast + 128) * transform.brightness;
+    int level = std::max(0, std::min(255, static_cast<int>(adjusted + 0.5f)));
+    if (transform.invert) {
+      level = 255 - level;
+    }
+    for (int channel = 0; channel < 3; channel++) {
+      this->color_lut_[channel * 256 + value] = (level * tint[channel] + 127) / 255;
+    }
+  }
+}
+
+void LocalImage::draw_scaled(int x, int y, int width, int height, display::Display *display, ScaleFilter filter,
+                             Color color_on, Color color_off) {
+  if (this->load_on_ == LOAD_ON_FIRST_DRAW && !this->first_draw_) {
+    this->first_draw_ = true;
+    this->defer_load_();
+  }
+  if (width <= 0 || height <= 0 || this->width_ <= 0 || this->height_ <= 0 || !this->is_drawable_()) {
+    return;
+  }
+  if (width == this->width_ && height == this->height_) {
+    this->draw(x, y, display, color_on, color_off);
+    return;
+  }
+
+  int dst_x0 = 0;
+  int dst_y0 = 0;
+  int dst_x2 = width;
+  int dst_y2 = height;
+  auto clipping = display->get_clipping();
+  if (clipping.is_set()) {
+    dst_x0 = std::max(dst_x0, clipping.x - x);
+    dst_y0 = std::max(dst_y0, clipping.y - y);
+    dst_x2 = std::min(dst_x2, clipping.x2() - x);
+    dst_y2 = std::min(dst_y2, clipping.y2() - y);
+  }
+  if (dst_x0 >= dst_x2 || dst_y0 >= dst_y2)
+    return;
+
+  // Source positions in 16.16 fixed point, sampled at the center of each display pixel.
+  const uint32_t step_x = (static_cast<uint32_t>(this->width_) << 16) / width;
+  const uint32_t step_y = (static_cast<uint32_t>(this->height_) << 16) / height;
+  const bool box = filter == SCALE_BOX;
+  // A compressed row is expanded into the line buffer, so the second row of a box goes into its second half.
+  uint8_t *next_row = box && !this->compressed_.empty() ? this->line_buffer_ + this->get_stride_() : nullptr;
+
+  int row_y = -1;
+  const uint8_t *row0 = nullptr;
+  const uint8_t *row1 = nullptr;
+  const uint8_t *mask0 = nullptr;
+  const uint8_t *mask1 = nullptr;
+  for (int dst_y = dst_y0; dst_y < dst_y2; dst_y++) {
+    uint32_t pos_y = dst_y * step_y + step_y / 2;
+    int src_y;
+    if (box) {
+      src_y = pos_y > 0x8000 ? (pos_y - 0x8000) >> 16 : 0;
+    } else {
+      src_y = pos_y >> 16;
+    }
+    src_y = std::min(src_y, this->height_ - 1);
+    if (src_y != row_y) {
+      // Rows repeated when enlarging are fetched, and expanded, only once.
+      row_y = src_y;
+      int next_y = std::min(src_y + 1, this->height_ - 1);
+      if (next_row != nullptr) {
+        this->compressed_.decode_row(next_y, next_row);
+        row1 = next_row;
+      } else if (box) {
+        row1 = this->get_row_(next_y);
+      }
+      row0 = this->get_row_(src_y);
+      mask0 = this->get_mask_row_(src_y);
+      mask1 = this->get_mask_row_(next_y);
+    }
+
+    uint32_t pos_x = dst_x0 * step_x + step_x / 2;
+    for (int dst_x = dst_x0; dst_x < dst_x2; dst_x++, pos_x += step_x) {
+      Color color;
+      if (box) {
+        int x0 = std::min<int>(pos_x > 0x8000 ? (pos_x - 0x8000) >> 16 : 0, this->width_ - 1);
+        int x1 = std::min(x0 + 1, this->width_ - 1);
+        Color c00 = this->get_pixel_(row0, mask0, x0, color_on, color_off);
+        Color c01 = this->get_pixel_(row0, mask0, x1, color_on, color_off);
+        Color c10 = this->get_pixel_(row1, mask1, x0, color_on, color_off);
+        Color c11 = this->get_pixel_(row1, mask1, x1, color_on, color_off);
+        color = Color((c00.r + c01.r + c10.r + c11.r + 2) >> 2, (c00.g + c01.g + c10.g + c11.g + 2) >> 2,
+                      (c00.b + c01.b + c10.b + c11.b + 2) >> 2, (c00.w + c01.w + c10.w + c11.w + 2) >> 2);
+      } else {
+        color = this->get_pixel_(row0, mask0, std::min<int>(pos_x >> 16, this->width_ - 1), color_on, color_off);
+      }
+      if (color.w >= 0x80) {
+        display->draw_pixel_at(x + dst_x, y + dst_y, this->transform_color_(color));
+      }
+    }
+  }
+}
+
+/**********************************************************************************************
+ *
+ * @brief Do load and decode image.
+ *
+ */
+void LocalImage::loop() {
+  if (this->load_deferred_ && static_cast<int32_t>(millis() - this->retry_at_) >= 0) {
+    if (this->provider_->is_ready()) {
+      this->request_load(this->path_);
+    } else {
+      // Back off up to LOAD_RETRY_MAX_DELAY, storage may take long to come up (or a card to be inserted).
+      this->retry_delay_ = std::min(std::max(this->retry_delay_ * 2, LOAD_RETRY_MIN_DELAY), LOAD_RETRY_MAX_DELAY);
+      this->retry_at_ = millis() + this->retry_delay_;
+      ESP_LOGV(TAG, "Storage not ready, retry loading %s in %" PRIu32 " ms", this->path_.c_str(), this->retry_delay_);
+    }
+  }
+
+  if (this->watch_interval_ > 0 && !this->loading_ && !this->checking_ && this->loaded_fingerprint_.valid) {
+    uint32_t now = millis();
+    if (now - this->last_watch_ >= this->watch_interval_) {
+      this->last_watch_ = now;
+      // Only sizes are polled here. With HEAD and FULL the requested load compares the hashes in
+      // time slices of the scheduler and is skipped if they match.
+      if (this->fingerprint_mode_ != FINGERPRINT_SIZE || this->sizes_changed_(false)) {
+        this->request_load(this->loaded_path_);
+        this->watch_request_ = true;
+      }
+    }
+  }
+
+  if (this->progressive_ && this->loading_ && this->progress_y2_ != this->progress_reported_) {
+    uint32_t now = millis();
+    if (now - this->last_progress_ >= this->progress_interval_) {
+      this->last_progress_ = now;
+      this->progress_reported_ = this->progress_y2_;
+      this->progress_callback_.call(this->get_revealed_area());
+    }
+  }
+
+  if (this->image_loaded_) {
+    this->load_finished_callback_.call(this->dirty_rects_);
+    this->image_loaded_ = false;
+  }
+
+  if (this->last_error_ != ErrorCode::OK) {
+    this->on_err_callback_.call(static_cast<uint8_t>(this->last_error_));
+    this->last_error_ = ErrorCode::OK;
+  }
+  return;
+}
+
+void LocalImage::map_chroma_key(Color &color) {
+  if (this->transparency_ == image::TRANSPARENCY_CHROMA_KEY) {
+    if (color.g == 1 && color.r == 0 && color.b == 0) {
+      color.g = 0;
+    }
+    if (color.w < 0x80) {
+      color.r = 0;
+      color.g = this->type_ == ImageType::IMAGE_TYPE_RGB565 ? 4 : 1;
+      color.b = 0;
+    }
+  }
+}
+
+void LocalImage::transform_position_(int &x, int &y) const {
+  const int width = this->get_decode_width_();
+  const int height = this->get_decode_height_();
+  if (this->mirror_x_)
+    x = width - 1 - x;
+  if (this->mirror_y_)
+    y = height - 1 - y;
+  switch (this->rotation_) {
+    case 90: {
+      int tmp = x;
+      x = height - 1 - y;
+      y = tmp;
+      break;
+    }
+    case 180:
+      x = width - 1 - x;
+      y = height - 1 - y;
+      break;
+    case 270: {
+      int tmp = x;
+      x = y;
+      y = width - 1 - tmp;
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void LocalImage::draw_pixel_(int x, int y, Color color) {
+  if (this->is_direct_()) {
+    this->draw_band_pixel_(x, y, color);
+    return;
+  }
+  if (!this->buffer_) {
+    ESP_LOGE(TAG, "Buffer not allocated!");
+    return;
+  }
+  const int decode_y = y;
+  if (this->rotation_ != 0 || this->mirror_x_ || this->mirror_y_) {
+    this->transform_position_(x, y);
+  }
+  if (x < 0 || y < 0 || x >= this->buffer_width_ || y >= this->buffer_height_) {
+    ESP_LOGE(TAG, "Tried to paint a pixel (%d,%d) outside the image!", x, y);
+    return;
+  }
+  if (this->progressive_) {
+    // Decoders write row by row (BMP bottom up), so the rows between the first and the last one written are done.
+    if (decode_y < this->progress_y1_)
+      this->progress_y1_ = decode_y;
+    if (decode_y > this->progress_y2_)
+      this->progress_y2_ = decode_y;
+  }
+  if (this->load_stats_ != nullptr) {
+    if (this->parallel_decode_) {
+      this->band_stats_[decode_y / this->band_stats_rows_].add(x, y, color);
+    } else {
+      this->load_stats_->add(x, y, color);
+    }
+  }
+  this->store_pixel_(x, y, color);
+}
+
+void LocalImage::store_pixel_(int x, int y, Color color) {
+  if (this->packing_ != PACKING_NONE) {
+    this->draw_packed_pixel_(x, y, color);
+    return;
+  }
+  if (this->mask_ != nullptr) {
+    uint8_t &bits = this->mask_[y * this->get_mask_stride_() + x / 8];
+    const uint8_t bit = 0x80 >> (x & 7);
+    const uint8_t opaque = color.w >= 0x80 ? bit : 0;
+    if ((bits & bit) != opaque) {
+      bits ^= bit;
+      this->mark_changed_(x, y);
+    }
+  }
+  // Dithering uses buffer coordinates, so that the pattern lines up with the display.
+  const int threshold =
+      this->dither_ == DITHER_ORDERED && this->transparency_ != image::TRANSPARENCY_CHROMA_KEY ? BAYER4[y & 3][x & 3]
+                                                                                                : -1;
+  uint32_t pos = this->get_position_(x, y);
+  uint8_t pixel[4];
+  size_t len = 0;
+  switch (this->type_) {
+    case ImageType::IMAGE_TYPE_BINARY: {
+      const uint32_t width_8 = ((this->width_ + 7u) / 8u) * 8u;
+      pos = x + y * width_8;
+      auto bitno = 0x80 >> (pos % 8u);
+      pos /= 8u;
+      auto on = threshold < 0 ? is_color_on(color)
+                              : ((color.r >> 2) + (color.g >> 1) + (color.b >> 2)) > threshold * 16 + 8;
+      if (this->has_transparency() && color.w < 0x80)
+        on = false;
+      if (on == ((this->buffer_[pos] & bitno) != 0)) {
+        return;
       }
+      if (on) {
+        this->buffer_[pos] |= bitno;
+      } else {
+        this->buffer_[pos] &= ~bitno;
+      }
+      this->mark_changed_(x, y);
+      return;
+    }
+    case ImageType::IMAGE_TYPE_GRAYSCALE: {
+      uint8_t gray = static_cast<uint8_t>(0.2125 * color.r + 0.7154 * color.g + 0.0721 * color.b);
+      if (this->transparency_ == image::TRANSPARENCY_CHROMA_KEY) {
+        if (gray == 1) {
+          gray = 0;
+        }
+        if (color.w < 0x80) {
+          gray = 1;
+        }
+      } else if (this->transparency_ == image::TRANSPARENCY_ALPHA_CHANNEL) {
+        if (color.w != 0xFF)
+          gray = color.w;
+      }
+      pixel[0] = gray;
+      len = 1;
       break;
     }
+    case ImageType::IMAGE_TYPE_RGB565: {
+      this->map_chroma_key(color);
+      uint16_t col565 = threshold < 0 ? display::ColorUtil::color_to_565(color)
+                                      : (quantize_channel(color.r, 5, threshold) << 11) |
+                                            (quantize_channel(color.g, 6, threshold) << 5) |
+                                            quantize_channel(color.b, 5, threshold);
+      if (RGB565_BIG_ENDIAN) {
+        pixel[0] = static_cast<uint8_t>((col565 >> 8) & 0xFF);
+        pixel[1] = static_cast<uint8_t>(col565 & 0xFF);
+      } else {
+        pixel[0] = static_cast<uint8_t>(col565 & 0xFF);
+        pixel[1] = static_cast<uint8_t>((col565 >> 8) & 0xFF);
+      }
+      pixel[2] = color.w;
+      len = this->transparency_ == image::TRANSPARENCY_ALPHA_CHANNEL ? 3 : 2;
+      break;
+    }
+    case ImageType::IMAGE_TYPE_RGB: {
+      this->map_chroma_key(color);
+      pixel[0] = color.r;
+      pixel[1] = color.g;
+      pixel[2] = color.b;
+      pixel[3] = color.w;
+      len = this->transparency_ == image::TRANSPARENCY_ALPHA_CHANNEL ? 4 : 3;
+      break;
+    }
+  }
+  // Only pixels that really change are written, so that the changed area is known after decoding.
+  if (memcmp(this->buffer_ + pos, pixel, len) != 0) {
+    memcpy(this->buffer_ + pos, pixel, len);
+    this->mark_changed_(x, y);
+  }
+}
+
+void LocalImage::draw_packed_pixel_(int x, int y, Color color) {
+  const int threshold = this->dither_ == DITHER_ORDERED ? BAYER4[y & 3][x & 3] : -1;
+  uint8_t value;
+  if (this->packing_ == PACKING_RGB332) {
+    value = (quantize_channel(color.r, 3, threshold) << 5) | (quantize_channel(color.g, 3, threshold) << 2) |
+            quantize_channel(color.b, 2, threshold);
+  } else {
+    // Integer version of 0.2125 * R + 0.7154 * G + 0.0721 * B.
+    uint8_t gray = (color.r * 54 + color.g * 183 + color.b * 19) >> 8;
+    value = quantize_channel(gray, this->get_bpp(), threshold);
+  }
+  const size_t bit = x * this->get_bpp();
+  const uint8_t shift = 8u - this->get_bpp() - bit % 8u;
+  const uint8_t mask = ((1u << this->get_bpp()) - 1u) << shift;
+  uint8_t *byte = this->buffer_ + y * this->get_stride_() + bit / 8u;
+  const uint8_t packed = (*byte & ~mask) | (value << shift);
+  if (packed != *byte) {
+    *byte = packed;
+    this->mark_changed_(x, y);
   }
 }
 
-void LocalImage::add_on_finished_callback(std::function<void()> &&callback) {
+display::Rect LocalImage::get_revealed_area() const {
+  if (!this->loading_) {
+    return this->has_image_() ? display::Rect(0, 0, this->width_, this->height_) : display::Rect();
+  }
+  if (this->progress_y2_ < this->progress_y1_) {
+    return display::Rect();
+  }
+  int x1 = 0;
+  int y1 = this->progress_y1_;
+  int x2 = this->get_decode_width_() - 1;
+  int y2 = this->progress_y2_;
+  if (this->rotation_ != 0 || this->mirror_x_ || this->mirror_y_) {
+    this->transform_position_(x1, y1);
+    this->transform_position_(x2, y2);
+  }
+  return display::Rect(std::min(x1, x2), std::min(y1, y2), std::abs(x2 - x1) + 1, std::abs(y2 - y1) + 1);
+}
+
+display::Rect LocalImage::get_changed_area() const {
+  if (this->changed_x2_ < this->changed_x1_) {
+    return display::Rect();
+  }
+  return display::Rect(this->changed_x1_, this->changed_y1_, this->changed_x2_ - this->changed_x1_ + 1,
+                       this->changed_y2_ - this->changed_y1_ + 1);
+}
+
+#ifdef USE_LVGL
+lv_img_dsc_t *LocalImage::get_lv_img_dsc() {
+  if (this->load_on_ == LOAD_ON_FIRST_DRAW && !this->first_draw_) {
+    this->first_draw_ = true;
+    this->defer_load_();
+  }
+  // The buffer may be reused for an image of another size, so the header is refreshed on every call.
+  Image::get_lv_img_dsc();
+#if LV_COLOR_DEPTH == 8
+  if (this->packing_ == PACKING_RGB332 && this->compressed_.empty()) {
+    // RGB332 is the native color format of LVGL at 8 bit color depth.
+    this->dsc_.header.cf = LV_IMG_CF_TRUE_COLOR;
+    this->dsc_.data = this->buffer_;
+    this->dsc_.header.w = this->width_;
+    this->dsc_.header.h = this->height_;
+    this->dsc_.data_size = this->buffer_ == nullptr ? 0 : this->get_width_stride() * this->height_;
+    return &this->dsc_;
+  }
+#endif
+  this->dsc_.data = this->data_start_;
+  this->dsc_.header.w = this->width_;
+  this->dsc_.header.h = this->height_;
+  this->dsc_.data_size = this->data_start_ == nullptr ? 0 : this->get_width_stride() * this->height_;
+  if (this->data_start_ == nullptr && this->has_image_()) {
+    ESP_LOGW(TAG, "Compressed, packed or masked images can not be shown by LVGL");
+  }
+  return &this->dsc_;
+}
+
+void LocalImage::zoom_lvgl(lv_obj_t *obj, int width, int height, bool antialias) {
+  if (this->width_ <= 0 || this->height_ <= 0) {
+    return;
+  }
+  // LV_IMG_ZOOM_NONE (256) is the original size.
+  uint32_t zoom = std::min(static_cast<uint32_t>(width) * LV_IMG_ZOOM_NONE / this->width_,
+                           static_cast<uint32_t>(height) * LV_IMG_ZOOM_NONE / this->height_);
+  zoom = std::max<uint32_t>(1, std::min<uint32_t>(zoom, UINT16_MAX));
+  lv_img_set_pivot(obj, 0, 0);
+  lv_img_set_antialias(obj, antialias);
+  lv_img_set_zoom(obj, zoom);
+  // The widget takes the zoomed size, so layouts see the thumbnail size.
+  lv_img_set_size_mode(obj, LV_IMG_SIZE_MODE_REAL);
+}
+
+void LocalImage::invalidate_lvgl(lv_obj_t *obj) {
+  lv_coord_t old_w = this->dsc_.header.w;
+  lv_coord_t old_h = this->dsc_.header.h;
+  const void *old_data = this->dsc_.data;
+  lv_img_dsc_t *dsc = this->get_lv_img_dsc();
+  lv_img_cache_invalidate_src(dsc);
+
+  if (lv_img_get_src(obj) != dsc || old_data != dsc->data || old_w != dsc->header.w || old_h != dsc->header.h) {
+    // New source or new size: the widget has to take the new descriptor and relayout.
+    lv_img_set_src(obj, dsc);
+    return;
+  }
+
+  if (this->dirty_rects_.empty()) {
+    return;
+  }
+  if (lv_img_get_zoom(obj) != LV_IMG_ZOOM_NONE || lv_img_get_angle(obj) != 0) {
+    lv_obj_invalidate(obj);
+    return;
+  }
+  lv_area_t coords;
+  lv_obj_get_coords(obj, &coords);
+  for (auto &area : this->dirty_rects_) {
+    lv_area_t changed;
+    changed.x1 = coords.x1 + area.x;
+    changed.y1 = coords.y1 + area.y;
+    changed.x2 = changed.x1 + area.w - 1;
+    changed.y2 = changed.y1 + area.h - 1;
+    lv_obj_invalidate_area(obj, &changed);
+  }
+}
+#endif  // USE_LVGL
+
+void LocalImage::add_on_finished_callback(std::function<void(const std::vector<display::Rect> &)> &&callback) {
   this->load_finished_callback_.add(std::move(callback));
 }
 
+void LocalImage::add_on_progress_callback(std::function<void(display::Rect)> &&callback) {
+  this->progress_callback_.add(std::move(callback));
+}
+
 void LocalImage::add_on_error_callback(std::function<void(uint8_t)> &&callback) {
   // this->on_err_callback_.add(std::move(callback));
   this->on_err_callback_.add(std::move(callback));
@@ -11,6 +11,10 @@
 #include "esphome/components/storage/file_provider.h"
 #include "esphome/components/image/image.h"
 #include "image_decoder.h"
+#include "file_cache.h"
+#include "image_stats.h"
+#include "read_ahead.h"
+#include "rle_buffer.h"
 
 namespace esphome {
 namespace local_image {
@@ -37,14 +41,149 @@ enum ImageFormat {
   PNG,
   /** BMP format. */
   BMP,
+  /** QOI format. */
+  QOI,
 };
 
+/**
+ * @brief How the decoded image is kept in memory.
+ */
+enum StorageCompression {
+  /** Plain pixel buffer. */
+  COMPRESSION_NONE,
+  /** Run-length encoded rows, expanded row by row on draw. */
+  COMPRESSION_RLE,
+};
+
+/**
+ * @brief Packed pixel layout used instead of the one of the image type, to save memory.
+ * Pixels are packed most significant bits first, rows start on a byte boundary.
+ */
+enum PixelPacking {
+  /** Layout of the image type. */
+  PACKING_NONE,
+  /** 4 gray levels, 4 pixels per byte. */
+  PACKING_GRAY2,
+  /** 16 gray levels, 2 pixels per byte. */
+  PACKING_GRAY4,
+  /** 3 bits red, 3 bits green and 2 bits blue in one byte. */
+  PACKING_RGB332,
+};
+
+/**
+ * @brief Dithering applied when colors are reduced while decoding.
+ */
+enum DitherMode {
+  DITHER_NONE,
+  /** 4x4 Bayer matrix, stable between reloads so unchanged areas stay unchanged. */
+  DITHER_ORDERED,
+};
+
+/**
+ * @brief When the configured image is loaded first.
+ */
+enum LoadOn {
+  /** Right after boot, as soon as the storage is ready. */
+  LOAD_ON_BOOT,
+  /** When the image is drawn the first time. */
+  LOAD_ON_FIRST_DRAW,
+  /** Only by an action or from a lambda. */
+  LOAD_ON_MANUAL,
+};
+
+/**
+ * @brief How draw_scaled() samples the image.
+ */
+enum ScaleFilter {
+  /** Nearest pixel, sharp and fastest. */
+  SCALE_NEAREST,
+  /** Average of 2x2 pixels, smoother when shrinking. */
+  SCALE_BOX,
+};
+
+/**
+ * @brief What is compared to detect that a file is unchanged since it was loaded.
+ */
+enum FingerprintMode {
+  /** Always reload. */
+  FINGERPRINT_NONE,
+  /** File size only. */
+  FINGERPRINT_SIZE,
+  /** File size and a hash of the first block of the file. */
+  FINGERPRINT_HEAD,
+  /** File size and a hash of the whole file. Still skips decoding, but not reading. */
+  FINGERPRINT_FULL,
+};
+
+/**
+ * @brief Identifies the content of a loaded file.
+ */
+struct FileFingerprint {
+  size_t size{0};
+  uint32_t hash{0};
+  bool valid{false};
+
+  bool operator==(const FileFingerprint &other) const {
+    return this->valid && other.valid && this->size == other.size && this->hash == other.hash;
+  }
+};
+
+/**
+ * @brief Timing of the last image load.
+ */
+struct LoadMetrics {
+  /** Bytes read from the file. */
+  size_t bytes_read{0};
+  /** Time spent reading the file, in microseconds. */
+  uint32_t read_us{0};
+  /** Time the decoder waited for read ahead data, in microseconds. */
+  uint32_t wait_us{0};
+  /** Time spent in the decoder, in microseconds. */
+  uint32_t decode_us{0};
+  /** Time from start to end of the load, in microseconds. */
+  uint32_t total_us{0};
+
+  /** Achieved read throughput in MB/s. */
+  float read_mbps() const { return this->read_us == 0 ? 0.0f : static_cast<float>(this->bytes_read) / this->read_us; }
+};
+
+/**
+ * @brief How an image load is run, chosen from the image header and the free memory.
+ */
+struct LoadPlan {
+  /** Read the next block on a separate thread. */
+  bool read_ahead{false};
+  /** JPEG images are decoded at 1/jpeg_scale of their size (1, 2, 4 or 8). */
+  uint8_t jpeg_scale{1};
+  /** Memory the load was expected to allocate, in bytes. 0 if it was not planned. */
+  size_t memory{0};
+};
+
+/**
+ * @brief Color adjustment applied while the image is drawn, the image buffer is not changed.
+ */
+struct ColorTransform {
+  /** Factor for all channels, 1 keeps the image unchanged. */
+  float brightness{1.0f};
+  /** Factor for the distance of the channels from mid gray, 1 keeps the image unchanged. */
+  float contrast{1.0f};
+  /** Channels are multiplied with it, white keeps the image unchanged. */
+  Color tint{255, 255, 255};
+  bool invert{false};
+
+  bool is_identity() const {
+    return this->brightness == 1.0f && this->contrast == 1.0f && this->tint.r == 255 && this->tint.g == 255 &&
+           this->tint.b == 255 && !this->invert;
+  }
+};
+
+class LoadScheduler;
+
 /**
  * @brief Download an image from a given URL, and decode it using the specified decoder.
  * The image will then be stored in a buffer, so that it can be re-displayed without the
  * need to re-download or re-decode.
  */
-
 class LocalImage : public Component, public image::Image {
  public:
   /**
@@ -62,11 +201,190 @@ class LocalImage : public Component, public image::Image {
   void loop() override;
 
   void set_path(const std::string &path);
+  const std::string &get_path() const { return this->path_; }
   void set_storage(storage::FileProvider *file_provider);
+  void set_compression(StorageCompression compression) {
+    this->compression_ = compression;
+    this->loaded_fingerprint_.valid = false;
+  }
+  void set_scheduler(LoadScheduler *scheduler) { this->scheduler_ = scheduler; }
+
+  /**
+   * @brief Store pixels packed with fewer bits than the image type uses.
+   * Must be set before the first load, the buffer layout depends on it.
+   */
+  void set_packing(PixelPacking packing);
+  /**
+   * @brief Keep transparency in a separate plane of one bit per pixel instead of an alpha
+   * byte per pixel. Colors are stored at the native depth of the image type.
+   * Must be set before the first load, the buffer layout depends on it.
+   */
+  void set_transparency_mask(bool mask) {
+    this->use_mask_ = mask;
+    this->loaded_fingerprint_.valid = false;
+  }
+  /** Dither colors reduced to BINARY, RGB565 or a packed layout. */
+  void set_dither(DitherMode dither) {
+    this->dither_ = dither;
+    this->loaded_fingerprint_.valid = false;
+  }
+
+  /**
+   * @brief Collect statistics of the pixels while an image is decoded, see get_statistics().
+   * Uses about 2.5 KB per instance.
+   */
+  void set_statistics(bool enable);
+  /**
+   * @brief Statistics of the last loaded image: luminance histogram, average and dominant colors
+   * and the bounding box of the opaque pixels, in buffer coordinates. Overlays are not included.
+   *
+   * @return nullptr if statistics are disabled or no image was loaded since.
+   */
+  const ImageStats *get_statistics() const { return this->stats_valid_ ? this->stats_.get() : nullptr; }
+
+  /** Choose when the configured image is loaded first. */
+  void set_load_on(LoadOn load_on) { this->load_on_ = load_on; }
+
+  /**
+   * @brief Set the load priority. When several images wait for loading, the one with
+   * the highest priority is loaded first (e.g. images of the visible page).
+   */
+  void set_priority(int priority) { this->priority_ = priority; }
+  int get_priority() const { return this->priority_; }
+
+  /**
+   * @brief Set the size of the blocks the file is read in.
+   * With read ahead, two buffers of this size are used.
+   */
+  void set_read_buffer_size(size_t size) { this->read_chunk_size_ = size; }
+  /**
+   * @brief Keep the decoder and the source buffer allocated between loads, so that
+   * reloads do not allocate them again. Disable to save memory between loads.
+   */
+  void set_keep_decoder(bool keep_decoder) { this->keep_decoder_ = keep_decoder; }
+  /** Read the next block of the file on a separate thread while the current one is decoded. */
+  void set_read_ahead(bool read_ahead) { this->read_ahead_enabled_ = read_ahead; }
+  /**
+   * @brief Decode JPEG images in this many horizontal bands at the same time, on separate threads.
+   * Only used without rotation, vertical mirroring and progressive loading, and for normal loads.
+   */
+  void set_decode_threads(uint8_t threads) { this->decode_threads_ = threads; }
+
+  /**
+   * @brief Rotate the image clockwise while decoding, so it is stored in display orientation.
+   * With 90 or 270 degrees the stored width and height are swapped; a fixed size set
+   * with resize is the size after rotation.
+   *
+   * @param rotation 0, 90, 180 or 270 degrees.
+   */
+  void set_rotation(int rotation) {
+    this->rotation_ = rotation;
+    this->loaded_fingerprint_.valid = false;
+  }
+  /** Mirror the image horizontally while decoding (applied before rotation). */
+  void set_mirror_x(bool mirror_x) {
+    this->mirror_x_ = mirror_x;
+    this->loaded_fingerprint_.valid = false;
+  }
+  /** Mirror the image vertically while decoding (applied before rotation). */
+  void set_mirror_y(bool mirror_y) {
+    this->mirror_y_ = mirror_y;
+    this->loaded_fingerprint_.valid = false;
+  }
+
+  /**
+   * @brief Skip loading when the file and the output settings did not change since the
+   * last successful load.
+   */
+  void set_fingerprint_mode(FingerprintMode mode) { this->fingerprint_mode_ = mode; }
+  /**
+   * @brief Check the fingerprint of the file periodically from loop() and reload the
+   * image when it changed. 0 disables watching.
+   *
+   * @param interval Interval in milliseconds.
+   */
+  void set_watch_interval(uint32_t interval) { this->watch_interval_ = interval; }
+
+  /**
+   * @brief Show the image while it is decoded. draw() renders the rows decoded so far
+   * over the placeholder, and on_progress is called as rows arrive.
+   * JPEG images are decoded in one step, so they are shown only when complete.
+   */
+  void set_progressive(bool progressive) { this->progressive_ = progressive; }
+  /** Minimum time between two on_progress calls, in milliseconds. */
+  void set_progress_interval(uint32_t interval) { this->progress_interval_ = interval; }
+  /**
+   * @brief Area of the buffer holding decoded rows, in buffer coordinates.
+   * While loading progressively the part decoded so far, otherwise the whole image.
+   */
+  display::Rect get_revealed_area() const;
+
+  /**
+   * @brief Area of the buffer that changed during the last load, in buffer coordinates.
+   * Not set if nothing changed. The whole image if the buffer was (re)allocated.
+   */
+  display::Rect get_changed_area() const;
+
+  /**
+   * @brief Regions of the buffer that changed during the last load, in buffer coordinates.
+   * Found on a 16x16 pixel grid while pixels are written; when too many, only their bounding
+   * box is returned. After a reload with a different size this is the whole image.
+   */
+  const std::vector<display::Rect> &get_dirty_rects() const { return this->dirty_rects_; }
+
+#ifdef USE_LVGL
+  /**
+   * @brief Get the LVGL image descriptor, pointing straight at the image buffer.
+   * Unlike the base class, the header always follows the current image size.
+   */
+  lv_img_dsc_t *get_lv_img_dsc();
+
+  /**
+   * @brief Show the last loaded image in an LVGL image widget, redrawing only the changed regions.
+   * Use it in on_load_finished instead of lvgl.image.update.
+   *
+   * @param obj The LVGL image widget.
+   */
+  void invalidate_lvgl(lv_obj_t *obj);
+
+  /**
+   * @brief Let an LVGL image widget scale the image to fit into a box, keeping its aspect ratio.
+   * LVGL samples the image buffer, so one load serves every size.
+   *
+   * @param obj The LVGL image widget showing this image.
+   * @param width Width of the box.
+   * @param height Height of the box.
+   * @param antialias Interpolate between pixels instead of taking the nearest one.
+   */
+  void zoom_lvgl(lv_obj_t *obj, int width, int height, bool antialias = true);
+#endif
+
+  /** Timing of the last successful load. */
+  const LoadMetrics &get_load_metrics() const { return this->metrics_; }
+  /** Strategy chosen for the last load. */
+  const LoadPlan &get_load_plan() const { return this->plan_; }
 
   void map_chroma_key(Color &color);
   void draw(int x, int y, display::Display *display, Color color_on, Color color_off) override;
 
+  /**
+   * @brief Adjust the colors of the image when it is drawn, e.g. to dim it at night.
+   * Only lookup tables are rebuilt, the image is not decoded again. Images shown by LVGL
+   * straight from the buffer are not affected.
+   */
+  void set_color_transform(const ColorTransform &transform);
+  const ColorTransform &get_color_transform() const { return this->color_transform_; }
+
+  /**
+   * @brief Draw the image scaled to a size, sampled from the decoded buffer without decoding again.
+   *
+   * @param width Width on the display.
+   * @param height Height on the display.
+   * @param filter Sampling of the source pixels.
+   */
+  void draw_scaled(int x, int y, int width, int height, display::Display *display, ScaleFilter filter = SCALE_NEAREST,
+                   Color color_on = display::COLOR_ON, Color color_off = display::COLOR_OFF);
+
   /**
    * @brief Resize the image buffer to the requested dimensions.
    *
@@ -89,15 +407,65 @@ class LocalImage : public Component, public image::Image {
    * @param placeholder Pointer to the (@link Image) to show as placeholder.
    */
   void set_placeholder(image::Image *placeholder) { this->placeholder_ = placeholder; }
-  void add_on_finished_callback(std::function<void()> &&callback);
+  void add_on_finished_callback(std::function<void(const std::vector<display::Rect> &)> &&callback);
   void add_on_error_callback(std::function<void(uint8_t)> &&callback);
+  void add_on_progress_callback(std::function<void(display::Rect)> &&callback);
 
   /**
    * @brief Load image data from file to memory and decode to BMP format.
+   * The whole file is loaded before returning, bypassing the load scheduler.
    *
    */
   void load_image();
 
+  /**
+   * @brief Queue loading the image from a path in the load scheduler.
+   * Without scheduler the image is loaded right away. While the storage is not ready, the
+   * load is retried from loop() with increasing delay.
+   *
+   * @param path Path to the image file.
+   */
+  void request_load(const std::string &path);
+
+  /** Cancel loading and free the image, the decoder and all buffers. */
+  void release();
+
+  /**
+   * @brief Add an image blended over the loaded image, in the order added, at each load.
+   * Overlays are drawn at their own size, after resize and rotation of the image, so each
+   * refresh draws one image instead of several blended layers.
+   *
+   * @param path Path to the overlay file.
+   * @param x Left edge of the overlay, in buffer coordinates.
+   * @param y Top edge of the overlay, in buffer coordinates.
+   * @param format Format of the overlay file.
+   */
+  void add_overlay(const std::string &path, int x, int y, ImageFormat format);
+  void clear_overlays() { this->overlays_.clear(); }
+
+  /**
+   * @brief Decode an image straight to a display, without image buffer.
+   * Decoded rows are converted to RGB565 (RGB888 for type RGB) and sent band by band with
+   * Display::draw_pixels_at(), so only one band of rows is held in memory. Resize, rotation
+   * and mirroring apply as for normal loads, transparency is ignored. The image of a previous
+   * load is released. Queued like request_load().
+   *
+   * @param display Display to draw on.
+   * @param x Left edge on the display.
+   * @param y Top edge on the display.
+   * @param path Path to the image file.
+   */
+  void draw_direct(display::Display *display, int x, int y, const std::string &path);
+
+  /**
+   * @brief Grow the buffer holding the encoded file data.
+   * Used by decoders which need the whole file in memory at once.
+   *
+   * @param size Required size in bytes.
+   * @return 0 if no memory could be allocated, the size of the buffer otherwise.
+   */
+  size_t resize_source_buffer(size_t size);
+
  private:
   // size_t create_image_buffer_(size_t new_size);
   /**
@@ -112,15 +480,291 @@ class LocalImage : public Component, public image::Image {
    */
   void free_source_buffer_();
 
+  /**
+   * @brief Open the file and prepare the decoder.
+   *
+   * @param path Path to the image file.
+   * @return false if the load could not be started, last_error_ is set.
+   */
+  bool start_load_(const std::string &path);
+
+  /**
+   * @brief Read the next chunk of the file and feed it to the decoder.
+   *
+   * @return true when the load has finished, successfully or not.
+   */
+  bool process_load_();
+  /** Read the file and prepare the decoder, the part of start_load_() after the fingerprint check. */
+  bool begin_load_();
+
+  /**
+   * @brief Read the next chunk of the file into the source buffer.
+   *
+   * @return false on read error, the load is aborted.
+   */
+  bool read_chunk_();
+
+  /** Open a file for reading, or take it from the file cache. file_size_ must be set. */
+  bool open_source_(const std::string &path);
+  /** Copy data read at file_offset_ into the file cache entry being filled, if any. */
+  void fill_cache_(const uint8_t *data, size_t len);
+  /** Stop the reader, close the file and hand a filled entry to the file cache. */
+  void close_source_();
+  /** The file being loaded is read from the file cache. */
+  bool is_cached_() const;
+  /** Rewind after reading the header, a cached file is decoded in place from its start. */
+  void rewind_cached_();
+
+  /** Publish the decoded image and release the load resources. */
+  void finish_load_();
+
+  /** Close the file and release the decoder and the source buffer, unless they are kept. */
+  void abort_load_();
+
+  /** Free the decoder and the source buffer, unless they are kept for the next load. */
+  void release_decoder_();
+
+  /** Create the decoder for an image format, nullptr if the format is not supported. */
+  std::unique_ptr<ImageDecoder> create_decoder_(ImageFormat format);
+  /** The decoder of the running layer, the image or an overlay. */
+  ImageDecoder *active_decoder_() const {
+    return this->overlay_index_ >= 0 ? this->overlay_decoder_.get() : this->decoder_.get();
+  }
+
+  /**
+   * @brief A layer finished decoding: start the next overlay, or publish the image.
+   * Overlays which can not be loaded are left out.
+   *
+   * @return true when the load has finished.
+   */
+  bool finish_layer_();
+  /** Open an overlay file and prepare its decoder. */
+  bool start_overlay_(const std::string &path, ImageFormat format);
+  /** Pixels drawn by an overlay decoder, in overlay coordinates. */
+  void draw_overlay_(int x, int y, int w, int h, Color color);
+  /** Start a new band of overlay rows, after blending the previous one. */
+  void select_overlay_band_(int index);
+  /** Blend the current band of overlay rows into the buffer. */
+  void blend_band_();
+  /**
+   * @brief Blend a row of RGBA pixels into the buffer.
+   *
+   * @param x First buffer column.
+   * @param y Buffer row.
+   * @param rgba Pixels, 4 bytes each.
+   * @param count Number of pixels.
+   */
+  void blend_row_(int x, int y, const uint8_t *rgba, int count);
+
+  /**
+   * @brief The size of the image file or of an overlay file differs from the last load.
+   *
+   * @param strict Count files which can not be read, and overlays left out, as changed.
+   */
+  bool sizes_changed_(bool strict);
+  /** Start comparing the hashes of the loaded files, see process_check_(). */
+  bool start_check_();
+  /** Open the file of check_index_ for process_check_(). */
+  bool open_check_file_();
+  /**
+   * @brief Hash the next chunk of the checked file. Skips the load when all files match their
+   * fingerprints, or starts it when one differs.
+   *
+   * @return true when the load has finished, or was skipped.
+   */
+  bool process_check_();
+  /** Drop the image file and all overlay files from the file cache. */
+  void forget_cached_files_();
+  /** Drop a changed file from the file cache, so the next load reads it from storage. */
+  void forget_cached_(const std::string &path);
+
+  /** Add data read during a load at the current file offset to the fingerprint hash. */
+  void update_fingerprint_(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Choose how to load the image from its header (in the source buffer) and the
+   * largest free block of each memory type: with or without read ahead, and for JPEG
+   * images without fixed size, decoded at full or reduced scale.
+   *
+   * @return false if no strategy fits in memory.
+   */
+  bool plan_load_();
+  /** Check that the allocations of a plan fit in memory, and set its memory size. */
+  bool plan_fits_(LoadPlan &plan, int width, int height) const;
+  /** Memory allocated by a new decoder for the image format. */
+  size_t decoder_memory_() const;
+
+  /** Request loading the current path from loop(), once the storage is ready. */
+  void defer_load_();
+
+  /** Memory used by the band buffer of a direct load of an image of the given size. */
+  size_t direct_band_memory_(int width, int height) const;
+
+  /** Memory that loading an image from the given path will need, used by the scheduler. */
+  size_t estimate_load_memory_(const std::string &path);
+
+  /**
+   * @brief Replace the decoded buffer with its compressed copy.
+   * On failure the uncompressed buffer is kept.
+   */
+  void compress_image_buffer_();
+
+  /**
+   * @brief Draw an area of the image row by row, expanding compressed rows into the line buffer.
+   *
+   * @param area Part of the image to draw, in image coordinates.
+   */
+  void draw_rows_(int x, int y, display::Display *display, Color color_on, Color color_off,
+                  const display::Rect &area);
+
+  /** Apply the color transform to a pixel about to be drawn. */
+  ESPHOME_ALWAYS_INLINE Color transform_color_(Color color) const {
+    if (this->color_lut_.empty())
+      return color;
+    return Color(this->color_lut_[color.r], this->color_lut_[256 + color.g], this->color_lut_[512 + color.b],
+                 color.w);
+  }
+
+  /** Color of a pixel at buffer coordinates, transparent where the mask is clear. */
+  Color get_pixel_(const uint8_t *row, const uint8_t *mask, int x, Color color_on, Color color_off) const {
+    if (mask != nullptr && (mask[x / 8u] & (0x80 >> (x % 8u))) == 0)
+      return Color(0, 0, 0, 0);
+    return this->get_row_pixel_(row, x, color_on, color_off);
+  }
+
+  /** Draw the opaque pixels of a row of an image with transparency mask, from img_x0 up to img_x2 (exclusive). */
+  void draw_masked_row_(int x, int y, display::Display *display, Color color_on, Color color_off, int img_y,
+                        int img_x0, int img_x2, const uint8_t *mask);
+
+  /**
+   * @brief Get a pointer to the pixel data of a row. For compressed images the row
+   * is expanded into the line buffer, so the pointer is valid until the next call.
+   */
+  const uint8_t *get_row_(int y);
+
+  /**
+   * @brief Convert a pixel of a row (as returned by get_row_) to a color.
+   * Transparent pixels are returned with an alpha value below 0x80.
+   */
+  Color get_row_pixel_(const uint8_t *row, int x, Color color_on, Color color_off) const;
+
+  /** Convert a color to the packed layout and write it into the buffer. */
+  void draw_packed_pixel_(int x, int y, Color color);
+  /** Value of a pixel of a row with less than 8 bits per pixel, or of a packed layout. */
+  ESPHOME_ALWAYS_INLINE uint8_t get_packed_value_(const uint8_t *row, int x) const {
+    const size_t bit = x * this->get_bpp();
+    return (row[bit / 8u] >> (8u - this->get_bpp() - bit % 8u)) & ((1u << this->get_bpp()) - 1u);
+  }
+
+  /**
+   * @brief Allocate the transparency mask for the current buffer size, if enabled.
+   * A new mask is cleared, i.e. fully transparent.
+   *
+   * @return false if no memory could be allocated.
+   */
+  bool allocate_mask_();
+  /** Mask bits of a buffer row, or nullptr without mask. Bit 7 of the first byte is x = 0. */
+  const uint8_t *get_mask_row_(int y) const {
+    return this->mask_ == nullptr ? nullptr : this->mask_ + y * this->get_mask_stride_();
+  }
+  size_t get_mask_stride_() const { return (this->buffer_width_ + 7u) / 8u; }
+  size_t get_mask_size_(int width, int height) const {
+    return this->use_mask_ ? (width + 7u) / 8u * height : 0;
+  }
+
+  bool has_image_() const { return this->buffer_ != nullptr || !this->compressed_.empty(); }
+  /**
+   * A whole image can be drawn. While a load fills a new buffer, over several loop() calls,
+   * the placeholder is drawn instead.
+   */
+  bool is_drawable_() const { return this->buffer_complete_ && this->has_image_(); }
+
   RAMAllocator<uint8_t> allocator_{};
 
   uint32_t get_buffer_size_() const { return get_buffer_size_(this->buffer_width_, this->buffer_height_); }
   int get_buffer_size_(int width, int height) const { return (this->get_bpp() * width + 7u) / 8u * height; }
 
+  size_t get_stride_() const { return (this->get_bpp() * this->buffer_width_ + 7u) / 8u; }
+
   int get_position_(int x, int y) const { return (x + y * this->buffer_width_) * this->get_bpp() / 8; }
 
+  ESPHOME_ALWAYS_INLINE void mark_changed_(int x, int y) {
+    this->dirty_tiles_[(y >> DIRTY_TILE_SHIFT) * this->dirty_tiles_w_ + (x >> DIRTY_TILE_SHIFT)] = TILE_DIRTY;
+    if (this->parallel_decode_)
+      return;
+    if (x < this->changed_x1_)
+      this->changed_x1_ = x;
+    if (x > this->changed_x2_)
+      this->changed_x2_ = x;
+    if (y < this->changed_y1_)
+      this->changed_y1_ = y;
+    if (y > this->changed_y2_)
+      this->changed_y2_ = y;
+  }
+  void mark_all_changed_() {
+    this->resize_dirty_tiles_();
+    std::fill(this->dirty_tiles_.begin(), this->dirty_tiles_.end(), TILE_DIRTY);
+    this->changed_x1_ = 0;
+    this->changed_y1_ = 0;
+    this->changed_x2_ = this->buffer_width_ - 1;
+    this->changed_y2_ = this->buffer_height_ - 1;
+  }
+  void reset_changed_area_() {
+    std::fill(this->dirty_tiles_.begin(), this->dirty_tiles_.end(), TILE_CLEAN);
+    this->changed_x1_ = INT16_MAX;
+    this->changed_y1_ = INT16_MAX;
+    this->changed_x2_ = -1;
+    this->changed_y2_ = -1;
+  }
+
+  /** Number of threads to decode the running load with, 1 if the load can not be split. */
+  int get_decode_threads_() const;
+  /**
+   * @brief Workers decoding in parallel only mark dirty tiles, each in its own tile rows.
+   * The bounds of the changed area are taken from the tiles when they are done, and the
+   * statistics are collected per band of band_rows rows and added up.
+   */
+  void begin_parallel_decode_(int band_rows, int bands);
+  void end_parallel_decode_();
+
+  /** Size the dirty tile map for the current buffer dimensions. */
+  void resize_dirty_tiles_();
+  /** Merge the dirty tiles into rectangles. */
+  void build_dirty_rects_();
+  /** Mark the pixels of a buffer row that differ from the same row of the previous image. */
+  void diff_row_(int y, const uint8_t *old_row);
+
+  ESPHOME_ALWAYS_INLINE bool is_swapped_() const { return this->rotation_ == 90 || this->rotation_ == 270; }
+  /** Width of the decoded image before rotation, i.e. the coordinate space decoders draw in. */
+  int get_decode_width_() const { return this->is_swapped_() ? this->buffer_height_ : this->buffer_width_; }
+  /** Height of the decoded image before rotation. */
+  int get_decode_height_() const { return this->is_swapped_() ? this->buffer_width_ : this->buffer_height_; }
+
+  /**
+   * @brief Map a pixel position from decoder coordinates to its mirrored and rotated
+   * position in the buffer.
+   */
+  void transform_position_(int &x, int &y) const;
+
   ESPHOME_ALWAYS_INLINE bool is_auto_resize_() const { return this->fixed_width_ == 0 || this->fixed_height_ == 0; }
 
+  ESPHOME_ALWAYS_INLINE bool is_direct_() const { return this->direct_.display != nullptr; }
+  /** Bytes per pixel sent to the display by a direct load. */
+  size_t get_direct_bpp_() const { return this->type_ == image::IMAGE_TYPE_RGB ? 3 : 2; }
+  /**
+   * @brief Start a new band of a direct load, after sending the previous one to the display.
+   *
+   * @param index Decoder row unit the band holds.
+   * @param y1 First decoded row of the band.
+   * @param y2 Row after the last decoded row of the band.
+   */
+  void select_band_(int index, int y1, int y2);
+  /** Send the current band to the display. */
+  void flush_band_();
+  void free_band_();
+  /** Write a pixel, in decoder coordinates, into the current band. */
+  void draw_band_pixel_(int x, int y, Color color);
+
   /**
    * @brief Draw a pixel into the buffer.
    *
@@ -133,20 +777,172 @@ class LocalImage : public Component, public image::Image {
    * @param color 32 bit color to put into the pixel.
    */
   void draw_pixel_(int x, int y, Color color);
+  /** Convert a color to the storage format and write it at a buffer position. */
+  void store_pixel_(int x, int y, Color color);
 
   // void end_connection_();
 
-  CallbackManager<void()> load_finished_callback_{};
+  CallbackManager<void(const std::vector<display::Rect> &)> load_finished_callback_{};
   CallbackManager<void(uint8_t)> on_err_callback_{};
+  CallbackManager<void(display::Rect)> progress_callback_{};
 
   storage::FileProvider *provider_;
 
   std::unique_ptr<ImageDecoder> decoder_{nullptr};
 
   uint8_t *source_buffer_{nullptr};
+  /** Allocated size of source_buffer_. */
   size_t source_size_ = 0;
+  /** Number of bytes in source_buffer_ not yet consumed by the decoder. */
+  size_t source_len_ = 0;
+  /** Size of the chunks the file is read in. */
+  size_t read_chunk_size_ = 4096;
+
+  LoadScheduler *scheduler_{nullptr};
+  LoadOn load_on_{LOAD_ON_BOOT};
+  /** The first draw did request the load, see LOAD_ON_FIRST_DRAW. */
+  bool first_draw_{false};
+  /** A load waits for the storage, retried from loop() at retry_at_. */
+  bool load_deferred_{false};
+  uint32_t retry_at_{0};
+  uint32_t retry_delay_{0};
+  int priority_{0};
+  bool loading_ = false;
+  /** The fingerprints of the loaded files are compared before loading, see process_check_(). */
+  bool checking_{false};
+  /** File compared by the check, -1 for the image file, else the overlay. */
+  int check_index_{-1};
+  storage::FileObj *file_{nullptr};
+  size_t file_size_ = 0;
+  size_t file_offset_ = 0;
+
+  static const int DIRTY_TILE_SHIFT = 4;
+  enum TileState : uint8_t { TILE_CLEAN, TILE_DIRTY, TILE_COVERED };
+  /** One entry per 16x16 tile of the buffer, set when a pixel of the tile changes. */
+  std::vector<uint8_t> dirty_tiles_;
+  int dirty_tiles_w_{0};
+  std::vector<display::Rect> dirty_rects_;
+  /** Previous compressed image, kept during a reload of the same size to find the changes. */
+  RleBuffer previous_;
+
+  /** Bounding box of the pixels changed by the last load, empty if x2 < x1. */
+  int changed_x1_{INT16_MAX};
+  int changed_y1_{INT16_MAX};
+  int changed_x2_{-1};
+  int changed_y2_{-1};
+
+  int rotation_{0};
+  bool mirror_x_{false};
+  bool mirror_y_{false};
+
+  bool read_ahead_enabled_ = false;
+  uint8_t decode_threads_{1};
+  bool parallel_decode_{false};
+  bool keep_decoder_ = true;
+
+  bool progressive_ = false;
+  uint32_t progress_interval_{200};
+  uint32_t last_progress_{0};
+  /** First and last decoder row written by the running load. */
+  int progress_y1_{INT16_MAX};
+  int progress_y2_{-1};
+  /** Last row reported to on_progress. */
+  int progress_reported_{-1};
+#ifdef USE_LOCAL_IMAGE_READ_AHEAD
+  bool read_ahead_active_ = false;
+  ReadAhead read_ahead_;
+#endif
+#ifdef USE_LOCAL_IMAGE_FILE_CACHE
+  /** The file read from the cache, or nullptr when it is read from storage. */
+  const uint8_t *cached_{nullptr};
+  /** Bytes of the cached file passed to the decoder at once, doubled while it needs more. */
+  size_t cache_window_{0};
+  /** Cache entry filled while the file is read from storage. */
+  uint8_t *cache_fill_{nullptr};
+  size_t cache_fill_size_{0};
+#endif
+  LoadMetrics metrics_{};
+  LoadPlan plan_{};
+
+  /**
+   * Decoded rows per band of a direct load. A multiple of the JPEG MCU height, JPEG images
+   * are drawn MCU by MCU, the other formats row by row.
+   */
+  static const int DIRECT_BAND_ROWS = 16;
+  struct DirectTarget {
+    display::Display *display{nullptr};
+    int x{0};
+    int y{0};
+  };
+  /** Target of the next load, set by draw_direct(). */
+  DirectTarget direct_pending_{};
+  /** Target of the running load, no display for a normal load. */
+  DirectTarget direct_{};
+  struct Overlay {
+    std::string path;
+    int x;
+    int y;
+    ImageFormat format;
+    /** Of the file as blended by the last load, not valid if it was left out. */
+    FileFingerprint fingerprint;
+  };
+  std::vector<Overlay> overlays_;
+  /** Overlay being blended by the running load, -1 while the image itself is decoded. */
+  int overlay_index_{-1};
+  int overlay_width_{0};
+  int overlay_height_{0};
+  /** Size and fingerprint hash of the image file, kept while overlay files are read. */
+  size_t image_file_size_{0};
+  uint32_t image_hash_{0};
+  std::unique_ptr<ImageDecoder> overlay_decoder_{nullptr};
+  ImageFormat overlay_format_{ImageFormat::AUTO};
+  /**
+   * Rows of a direct load waiting to be sent to the display, stored as they are shown, or
+   * RGBA rows of an overlay waiting to be blended.
+   */
+  uint8_t *band_{nullptr};
+  size_t band_size_{0};
+  int band_index_{-1};
+  /** Area of the band in buffer coordinates, i.e. after rotation. */
+  display::Rect band_area_{};
+
+  FingerprintMode fingerprint_mode_{FINGERPRINT_NONE};
+  /** Fingerprint and path of the file the current image was loaded from. */
+  FileFingerprint loaded_fingerprint_{};
+  std::string loaded_path_;
+  /** Hash of the file data read by the running load. */
+  uint32_t load_hash_{0};
+  uint32_t watch_interval_{0};
+  uint32_t last_watch_{0};
+  /** The pending load was requested by the watch. */
+  bool watch_request_{false};
+  uint32_t load_start_{0};
   uint8_t *buffer_{nullptr};
   bool image_loaded_ = false;
+  /** The buffer holds a whole image, false from a new buffer or layout until its load finishes. */
+  bool buffer_complete_{false};
+
+  PixelPacking packing_{PACKING_NONE};
+  bool use_mask_{false};
+  /** Transparency mask, one bit per pixel, set for opaque pixels. Never compressed. */
+  uint8_t *mask_{nullptr};
+  size_t mask_size_{0};
+  DitherMode dither_{DITHER_NONE};
+  ColorTransform color_transform_{};
+  /** Statistics of the last loaded image, and of the running load. */
+  std::unique_ptr<ImageStats> stats_;
+  std::unique_ptr<ImageStats> load_stats_;
+  bool stats_valid_{false};
+  /** Statistics per band of a parallel decode. */
+  std::vector<ImageStats> band_stats_;
+  int band_stats_rows_{0};
+  /** Lookup tables of the color transform for red, green and blue, empty without transform. */
+  std::vector<uint8_t> color_lut_;
+  StorageCompression compression_{COMPRESSION_NONE};
+  RleBuffer compressed_;
+  /** Scratch buffer holding two expanded rows of a compressed image, see get_row_() and draw_scaled(). */
+  uint8_t *line_buffer_{nullptr};
+  size_t line_buffer_size_{0};
 
   ErrorCode last_error_;
 
@@ -178,8 +974,11 @@ class LocalImage : public Component, public image::Image {
    */
   int buffer_height_;
 
+  friend class LoadScheduler;
   friend bool ImageDecoder::set_size(int width, int height);
   friend void ImageDecoder::draw(int x, int y, int w, int h, const Color &color);
+  friend void ImageDecoder::draw_rows(int x, int y, int w, int h, const Color &color, int row_begin, int row_end);
+  friend class JpegDecoder;
 };
 
 }  // namespace local_image
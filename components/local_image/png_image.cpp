@@ -4,6 +4,7 @@
 #include "esphome/components/display/display_buffer.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
+#include "trace.h"
 
 static const char *const TAG = "local_image.png";
 
@@ -52,7 +53,16 @@ int PngDecoder::prepare(size_t download_size) {
   return 0;
 }
 
+void PngDecoder::reset() {
+  ImageDecoder::reset();
+  if (this->pngle_) {
+    // Keeps the inflate window and the callbacks, only the decoding state starts over.
+    pngle_reset(this->pngle_);
+  }
+}
+
 int HOT PngDecoder::decode(uint8_t *buffer, size_t size) {
+  LOCAL_IMAGE_TRACE_SCOPE("png decode");
   if (!this->pngle_) {
     ESP_LOGE(TAG, "PNG decoder engine not initialized!");
     return DECODE_ERROR_OUT_OF_MEMORY;
@@ -22,6 +22,7 @@ class PngDecoder : public ImageDecoder {
   ~PngDecoder() override { pngle_destroy(this->pngle_); }
 
   int prepare(size_t download_size) override;
+  void reset() override;
   int HOT decode(uint8_t *buffer, size_t size) override;
 
  protected:
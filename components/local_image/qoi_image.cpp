@@ -0,0 +1,155 @@
+#include "qoi_image.h"
+#ifdef USE_LOCAL_IMAGE_QOI_SUPPORT
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "trace.h"
+
+static const char *const TAG = "local_image.qoi";
+
+namespace esphome {
+namespace local_image {
+
+static const size_t QOI_HEADER_SIZE = 14;
+
+static const uint8_t QOI_OP_INDEX = 0x00;
+static const uint8_t QOI_OP_DIFF = 0x40;
+static const uint8_t QOI_OP_LUMA = 0x80;
+static const uint8_t QOI_OP_RUN = 0xC0;
+static const uint8_t QOI_OP_RGB = 0xFE;
+static const uint8_t QOI_OP_RGBA = 0xFF;
+static const uint8_t QOI_MASK_2 = 0xC0;
+
+static inline uint8_t qoi_hash(const uint8_t *px) { return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64; }
+
+void QoiDecoder::reset() {
+  ImageDecoder::reset();
+  this->header_read_ = false;
+  this->x_ = 0;
+  this->y_ = 0;
+  this->remaining_ = 0;
+  this->px_[0] = this->px_[1] = this->px_[2] = 0;
+  this->px_[3] = 255;
+  memset(this->index_, 0, sizeof(this->index_));
+}
+
+void QoiDecoder::emit_(uint32_t count) {
+  Color color(this->px_[0], this->px_[1], this->px_[2], this->px_[3]);
+  while (count > 0) {
+    uint32_t span = std::min(count, this->width_ - this->x_);
+    this->draw(this->x_, this->y_, span, 1, color);
+    count -= span;
+    this->x_ += span;
+    if (this->x_ == this->width_) {
+      this->x_ = 0;
+      this->y_++;
+    }
+  }
+}
+
+int HOT QoiDecoder::decode(uint8_t *buffer, size_t size) {
+  LOCAL_IMAGE_TRACE_SCOPE("qoi decode");
+  size_t index = 0;
+  if (!this->header_read_) {
+    /**
+     * QOI header:
+     * 0-3: Magic "qoif"
+     * 4-7: Width
+     * 8-11: Height
+     * 12: Channels (3 = RGB, 4 = RGBA)
+     * 13: Colorspace
+     *
+     * Integer values are stored in big-endian format.
+     */
+    if (size < QOI_HEADER_SIZE) {
+      return 0;
+    }
+    if (memcmp(buffer, "qoif", 4) != 0) {
+      ESP_LOGE(TAG, "Not a QOI file");
+      return DECODE_ERROR_INVALID_TYPE;
+    }
+    this->width_ = encode_uint32(buffer[4], buffer[5], buffer[6], buffer[7]);
+    this->height_ = encode_uint32(buffer[8], buffer[9], buffer[10], buffer[11]);
+    if (this->width_ == 0 || this->height_ == 0 || (buffer[12] != 3 && buffer[12] != 4)) {
+      ESP_LOGE(TAG, "Invalid QOI header: %" PRIu32 "x%" PRIu32 ", %u channels", this->width_, this->height_,
+               buffer[12]);
+      return DECODE_ERROR_UNSUPPORTED_FORMAT;
+    }
+    ESP_LOGD(TAG, "Image size: %" PRIu32 " x %" PRIu32 ", channels: %u", this->width_, this->height_, buffer[12]);
+    if (!this->set_size(this->width_, this->height_)) {
+      return DECODE_ERROR_OUT_OF_MEMORY;
+    }
+    this->remaining_ = static_cast<uint64_t>(this->width_) * this->height_;
+    this->header_read_ = true;
+    index = QOI_HEADER_SIZE;
+  }
+
+  // Only whole chunks are consumed, a chunk cut at the end of the buffer is decoded with the next one.
+  while (this->remaining_ > 0 && index < size) {
+    const uint8_t b1 = buffer[index];
+    size_t len = 1;
+    if (b1 == QOI_OP_RGBA) {
+      len = 5;
+    } else if (b1 == QOI_OP_RGB) {
+      len = 4;
+    } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+      len = 2;
+    }
+    if (size - index < len) {
+      break;
+    }
+
+    uint8_t *px = this->px_;
+    const uint8_t *chunk = buffer + index;
+    index += len;
+    if (b1 == QOI_OP_RGBA) {
+      memcpy(px, chunk + 1, 4);
+    } else if (b1 == QOI_OP_RGB) {
+      memcpy(px, chunk + 1, 3);
+    } else {
+      switch (b1 & QOI_MASK_2) {
+        case QOI_OP_INDEX:
+          memcpy(px, this->index_[b1], 4);
+          break;
+        case QOI_OP_DIFF:
+          px[0] += ((b1 >> 4) & 0x03) - 2;
+          px[1] += ((b1 >> 2) & 0x03) - 2;
+          px[2] += (b1 & 0x03) - 2;
+          break;
+        case QOI_OP_LUMA: {
+          int vg = (b1 & 0x3F) - 32;
+          px[0] += vg - 8 + ((chunk[1] >> 4) & 0x0F);
+          px[1] += vg;
+          px[2] += vg - 8 + (chunk[1] & 0x0F);
+          break;
+        }
+        default: {
+          // QOI_OP_RUN, the cache already holds the repeated pixel.
+          uint32_t run = std::min<uint64_t>((b1 & 0x3F) + 1, this->remaining_);
+          this->emit_(run);
+          this->remaining_ -= run;
+          continue;
+        }
+      }
+    }
+    memcpy(this->index_[qoi_hash(px)], px, 4);
+    this->emit_(1);
+    this->remaining_--;
+  }
+
+  if (this->remaining_ == 0) {
+    // Skip the end marker.
+    index = size;
+  }
+  this->decoded_bytes_ += index;
+  return index;
+}
+
+}  // namespace local_image
+}  // namespace esphome
+
+#endif  // USE_LOCAL_IMAGE_QOI_SUPPORT
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "image_decoder.h"
+#include "esphome/core/defines.h"
+#ifdef USE_LOCAL_IMAGE_QOI_SUPPORT
+
+namespace esphome {
+namespace local_image {
+
+/**
+ * @brief Image decoder specialization for QOI images (https://qoiformat.org).
+ *
+ * Decodes in a single streaming pass, keeping only the previous pixel and the
+ * 64 entry color cache of the format as state. Runs of equal pixels are drawn
+ * as horizontal spans.
+ */
+class QoiDecoder : public ImageDecoder {
+ public:
+  /**
+   * @brief Construct a new QOI Decoder object.
+   *
+   * @param image The image to decode the stream into.
+   */
+  QoiDecoder(LocalImage *image) : ImageDecoder(image) {}
+
+  void reset() override;
+  int HOT decode(uint8_t *buffer, size_t size) override;
+
+ protected:
+  /** Draw the current pixel count times, from the current position on. */
+  void emit_(uint32_t count);
+
+  bool header_read_{false};
+  uint32_t width_{0};
+  uint32_t height_{0};
+  uint32_t x_{0};
+  uint32_t y_{0};
+  /** Pixels not decoded yet. */
+  uint64_t remaining_{0};
+  /** Previous pixel, RGBA. */
+  uint8_t px_[4]{0, 0, 0, 255};
+  uint8_t index_[64][4]{};
+};
+
+}  // namespace local_image
+}  // namespace esphome
+
+#endif  // USE_LOCAL_IMAGE_QOI_SUPPORT
@@ -0,0 +1,206 @@
+#include "read_ahead.h"
+#ifdef USE_LOCAL_IMAGE_READ_AHEAD
+
+#include <chrono>
+#include <cstdlib>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include "trace.h"
+
+#ifdef USE_ESP32
+#include <esp_heap_caps.h>
+#include <esp_pthread.h>
+#endif
+
+static const char *const TAG = "local_image.read_ahead";
+
+namespace esphome {
+namespace local_image {
+
+static uint8_t *allocate_block(size_t size) {
+#ifdef USE_ESP32
+  // DMA capable memory lets the SDMMC driver transfer straight into the buffer, without bounce copies.
+  auto *block = static_cast<uint8_t *>(heap_caps_aligned_alloc(ReadAhead::ALIGNMENT, size, MALLOC_CAP_DMA));
+  if (block == nullptr) {
+    block = static_cast<uint8_t *>(heap_caps_aligned_alloc(ReadAhead::ALIGNMENT, size, MALLOC_CAP_8BIT));
+  }
+  return block;
+#else
+  return static_cast<uint8_t *>(aligned_alloc(ReadAhead::ALIGNMENT, size));
+#endif
+}
+
+static void free_block(uint8_t *block) {
+#ifdef USE_ESP32
+  heap_caps_free(block);
+#else
+  free(block);
+#endif
+}
+
+bool ReadAhead::start(storage::FileObj *file, size_t size, size_t block_size) {
+  this->stop();
+  this->block_size_ = (block_size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  for (auto &slot : this->slots_) {
+    slot.data = allocate_block(this->block_size_);
+    if (slot.data == nullptr) {
+      ESP_LOGE(TAG, "Allocation of read buffer of %zu bytes failed", this->block_size_);
+      this->stop();
+      return false;
+    }
+    slot.len = 0;
+    slot.state = SLOT_EMPTY;
+  }
+
+  this->file_ = file;
+  this->size_ = size;
+  this->read_ = 0;
+  this->read_time_us_ = 0;
+  this->stop_ = false;
+  this->eof_ = false;
+  this->error_ = false;
+  this->consumer_slot_ = 0;
+  this->acquired_ = false;
+
+#ifdef USE_ESP32
+  // Only the reader gets this config, the loop task gets its previous one back afterwards.
+  esp_pthread_cfg_t previous;
+  if (esp_pthread_get_cfg(&previous) != ESP_OK) {
+    previous = esp_pthread_get_default_config();
+  }
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = 3072;
+  cfg.thread_name = "local_image_rd";
+  // The main loop runs on core 1, keep the reader on the other core.
+  cfg.pin_to_core = 0;
+  esp_pthread_set_cfg(&cfg);
+#endif
+  this->thread_ = std::thread(&ReadAhead::reader_loop_, this);
+#ifdef USE_ESP32
+  esp_pthread_set_cfg(&previous);
+#endif
+  return true;
+}
+
+void ReadAhead::reader_loop_() {
+  uint8_t index = 0;
+  while (true) {
+    Slot &slot = this->slots_[index];
+    size_t want;
+    {
+      std::unique_lock<std::mutex> lock(this->lock_);
+      this->cond_.wait(lock, [this, &slot] { return this->stop_ || slot.state == SLOT_EMPTY; });
+      if (this->stop_) {
+        return;
+      }
+      want = std::min(this->block_size_, this->size_ - this->read_);
+    }
+
+    uint32_t start = micros();
+    size_t len;
+    bool error;
+    {
+      LOCAL_IMAGE_TRACE_SCOPE("read ahead");
+      len = want > 0 ? this->file_->read(slot.data, want) : 0;
+      error = this->file_->error() != 0;
+    }
+    uint32_t elapsed = micros() - start;
+
+    {
+      std::lock_guard<std::mutex> lock(this->lock_);
+      this->read_time_us_ += elapsed;
+      this->read_ += len;
+      if (error) {
+        this->error_ = true;
+      } else if (len == 0) {
+        this->eof_ = true;
+      } else {
+        slot.len = len;
+        slot.state = SLOT_FILLED;
+        if (this->read_ >= this->size_) {
+          this->eof_ = true;
+        }
+      }
+    }
+    this->cond_.notify_all();
+    if (error || len == 0 || this->read_ >= this->size_) {
+      return;
+    }
+    index ^= 1;
+  }
+}
+
+bool ReadAhead::acquire(uint8_t *&data, size_t &len, uint32_t timeout_ms) {
+  std::unique_lock<std::mutex> lock(this->lock_);
+  Slot &slot = this->slots_[this->consumer_slot_];
+  this->cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                       [this, &slot] { return slot.state == SLOT_FILLED || this->eof_ || this->error_; });
+  if (slot.state != SLOT_FILLED) {
+    return false;
+  }
+  data = slot.data;
+  len = slot.len;
+  this->acquired_ = true;
+  return true;
+}
+
+void ReadAhead::release() {
+  if (!this->acquired_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->lock_);
+    this->slots_[this->consumer_slot_].state = SLOT_EMPTY;
+  }
+  this->acquired_ = false;
+  this->consumer_slot_ ^= 1;
+  this->cond_.notify_all();
+}
+
+void ReadAhead::stop() {
+  {
+    std::lock_guard<std::mutex> lock(this->lock_);
+    this->stop_ = true;
+  }
+  this->cond_.notify_all();
+  if (this->thread_.joinable()) {
+    this->thread_.join();
+  }
+  for (auto &slot : this->slots_) {
+    if (slot.data != nullptr) {
+      free_block(slot.data);
+      slot.data = nullptr;
+    }
+    slot.state = SLOT_EMPTY;
+  }
+  this->file_ = nullptr;
+}
+
+bool ReadAhead::is_done() {
+  std::lock_guard<std::mutex> lock(this->lock_);
+  if (this->error_) {
+    return true;
+  }
+  return this->eof_ && this->slots_[0].state == SLOT_EMPTY && this->slots_[1].state == SLOT_EMPTY;
+}
+
+bool ReadAhead::has_error() {
+  std::lock_guard<std::mutex> lock(this->lock_);
+  return this->error_;
+}
+
+size_t ReadAhead::bytes_read() {
+  std::lock_guard<std::mutex> lock(this->lock_);
+  return this->read_;
+}
+
+uint32_t ReadAhead::read_time_us() {
+  std::lock_guard<std::mutex> lock(this->lock_);
+  return this->read_time_us_;
+}
+
+}  // namespace local_image
+}  // namespace esphome
+
+#endif  // USE_LOCAL_IMAGE_READ_AHEAD
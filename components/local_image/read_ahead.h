@@ -0,0 +1,100 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_LOCAL_IMAGE_READ_AHEAD
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "esphome/components/storage/file_provider.h"
+
+namespace esphome {
+namespace local_image {
+
+/**
+ * @brief Reads a file on a separate thread into two alternating buffers.
+ *
+ * While the decoder consumes one buffer, the next block of the file is read into the
+ * other one, so the storage controller and the CPU work at the same time.
+ * Buffers are sector aligned and, on ESP32, DMA capable so that the storage driver
+ * can transfer directly into them.
+ */
+class ReadAhead {
+ public:
+  ~ReadAhead() { this->stop(); }
+
+  /**
+   * @brief Allocate the buffers and start reading.
+   *
+   * @param file       Opened file. The reader owns it until stop() returns.
+   * @param size       Number of bytes to read.
+   * @param block_size Size of each buffer, rounded up to a multiple of ALIGNMENT.
+   * @return false if the buffers could not be allocated.
+   */
+  bool start(storage::FileObj *file, size_t size, size_t block_size);
+
+  /**
+   * @brief Get the next filled buffer.
+   *
+   * @param data       Set to the buffer data.
+   * @param len        Set to the number of bytes in the buffer.
+   * @param timeout_ms Maximum time to wait for the reader.
+   * @return false if no buffer is ready yet, or all data has been consumed (see is_done()).
+   */
+  bool acquire(uint8_t *&data, size_t &len, uint32_t timeout_ms);
+
+  /** Give back the buffer returned by the last acquire(). */
+  void release();
+
+  /** Stop the reader thread and free the buffers. */
+  void stop();
+
+  /** All data has been read and consumed, or reading failed. */
+  bool is_done();
+  bool has_error();
+
+  /** Total bytes read so far. */
+  size_t bytes_read();
+  /** Time the reader spent inside FileObj::read, in microseconds. */
+  uint32_t read_time_us();
+
+  static const size_t ALIGNMENT = 512;
+
+ protected:
+  enum SlotState : uint8_t { SLOT_EMPTY, SLOT_FILLED };
+
+  struct Slot {
+    uint8_t *data{nullptr};
+    size_t len{0};
+    SlotState state{SLOT_EMPTY};
+  };
+
+  void reader_loop_();
+
+  Slot slots_[2];
+  size_t block_size_{0};
+  storage::FileObj *file_{nullptr};
+
+  std::thread thread_;
+  std::mutex lock_;
+  std::condition_variable cond_;
+
+  // Protected by lock_
+  size_t size_{0};
+  size_t read_{0};
+  uint32_t read_time_us_{0};
+  bool stop_{false};
+  bool eof_{false};
+  bool error_{false};
+
+  // Only used by the consumer
+  uint8_t consumer_slot_{0};
+  bool acquired_{false};
+};
+
+}  // namespace local_image
+}  // namespace esphome
+
+#endif  // USE_LOCAL_IMAGE_READ_AHEAD
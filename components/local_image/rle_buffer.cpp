@@ -0,0 +1,124 @@
+#include "rle_buffer.h"
+
+#include "esphome/core/log.h"
+
+static const char *const TAG = "local_image.rle";
+
+namespace esphome {
+namespace local_image {
+
+/*
+ *  Packet header byte:
+ *    0..127   - literal run, (header + 1) units follow.
+ *    128..255 - repeat run, the following unit is repeated (header - 126) times.
+ */
+static const size_t MAX_LITERAL_RUN = 128;
+static const size_t MAX_REPEAT_RUN = 129;
+
+size_t RleBuffer::encode_row_(const uint8_t *src, uint8_t *dst) const {
+  const size_t units = this->stride_ / this->unit_;
+  size_t out = 0;
+  size_t i = 0;
+  while (i < units) {
+    size_t run = 1;
+    while (i + run < units && run < MAX_REPEAT_RUN && this->same_unit_(src, i, i + run))
+      run++;
+    if (run >= 2) {
+      if (dst != nullptr) {
+        dst[out] = static_cast<uint8_t>(126 + run);
+        memcpy(dst + out + 1, src + i * this->unit_, this->unit_);
+      }
+      out += 1 + this->unit_;
+      i += run;
+      continue;
+    }
+
+    size_t start = i;
+    size_t literal = 0;
+    while (i < units && literal < MAX_LITERAL_RUN) {
+      if (i + 1 < units && this->same_unit_(src, i, i + 1))
+        break;
+      i++;
+      literal++;
+    }
+    if (dst != nullptr) {
+      dst[out] = static_cast<uint8_t>(literal - 1);
+      memcpy(dst + out + 1, src + start * this->unit_, literal * this->unit_);
+    }
+    out += 1 + literal * this->unit_;
+  }
+  return out;
+}
+
+bool RleBuffer::encode(const uint8_t *src, size_t stride, int rows, size_t unit) {
+  this->clear();
+  if (unit == 0 || stride % unit != 0) {
+    ESP_LOGE(TAG, "Row stride %zu is not a multiple of the unit size %zu", stride, unit);
+    return false;
+  }
+  this->stride_ = stride;
+  this->unit_ = unit;
+
+  // First pass only measures, so that the compressed data is allocated in one block of the exact size.
+  std::vector<uint32_t> offsets(rows + 1);
+  size_t total = 0;
+  for (int row = 0; row < rows; row++) {
+    offsets[row] = total;
+    total += this->encode_row_(src + row * stride, nullptr);
+  }
+  offsets[rows] = total;
+
+  uint8_t *data = this->allocator_.allocate(total);
+  if (data == nullptr) {
+    ESP_LOGE(TAG, "Allocation of %zu bytes for compressed image failed", total);
+    return false;
+  }
+  for (int row = 0; row < rows; row++) {
+    this->encode_row_(src + row * stride, data + offsets[row]);
+  }
+
+  this->data_ = data;
+  this->size_ = total;
+  this->row_offsets_ = std::move(offsets);
+  ESP_LOGD(TAG, "Compressed %zu bytes to %zu bytes", stride * rows, total);
+  return true;
+}
+
+void RleBuffer::decode_row(int row, uint8_t *dst) const {
+  const uint8_t *pos = this->data_ + this->row_offsets_[row];
+  const uint8_t *end = this->data_ + this->row_offsets_[row + 1];
+  while (pos < end) {
+    uint8_t header = *pos++;
+    if (header < 128) {
+      size_t len = (header + 1) * this->unit_;
+      memcpy(dst, pos, len);
+      dst += len;
+      pos += len;
+    } else {
+      size_t count = header - 126;
+      if (this->unit_ == 1) {
+        memset(dst, *pos, count);
+        dst += count;
+      } else {
+        for (size_t i = 0; i < count; i++) {
+          memcpy(dst, pos, this->unit_);
+          dst += this->unit_;
+        }
+      }
+      pos += this->unit_;
+    }
+  }
+}
+
+void RleBuffer::clear() {
+  if (this->data_ != nullptr) {
+    this->allocator_.deallocate(this->data_, this->size_);
+    this->data_ = nullptr;
+  }
+  this->size_ = 0;
+  this->row_offsets_.clear();
+  this->row_offsets_.shrink_to_fit();
+}
+
+}  // namespace local_image
+}  // namespace esphome
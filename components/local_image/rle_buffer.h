@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+namespace local_image {
+
+/**
+ * @brief Row-indexed run-length encoded copy of an image buffer.
+ *
+ * Each row is encoded independently (PackBits style, on pixel sized units),
+ * and the start of every row is kept in an offset index, so a single row can be
+ * expanded without touching the rest of the image.
+ */
+class RleBuffer {
+ public:
+  ~RleBuffer() { this->clear(); }
+
+  /**
+   * @brief Compress an image buffer.
+   *
+   * @param src    Uncompressed image data.
+   * @param stride Number of bytes per row in src.
+   * @param rows   Number of rows in src.
+   * @param unit   Size of a pixel in bytes (1 for packed pixel formats). Must divide stride.
+   * @return true on success, false if the compressed data could not be allocated.
+   */
+  bool encode(const uint8_t *src, size_t stride, int rows, size_t unit);
+
+  /**
+   * @brief Expand a single row.
+   *
+   * @param row Row number.
+   * @param dst Destination, must be at least stride() bytes long.
+   */
+  void decode_row(int row, uint8_t *dst) const;
+
+  /** Release the compressed data. */
+  void clear();
+
+  /** Exchange the content with another buffer, without copying. */
+  void swap(RleBuffer &other) {
+    std::swap(this->data_, other.data_);
+    std::swap(this->size_, other.size_);
+    std::swap(this->stride_, other.stride_);
+    std::swap(this->unit_, other.unit_);
+    this->row_offsets_.swap(other.row_offsets_);
+  }
+
+  bool empty() const { return this->data_ == nullptr; }
+  /** Size of the compressed data, without the row index. */
+  size_t size() const { return this->size_; }
+  size_t stride() const { return this->stride_; }
+  int rows() const { return this->row_offsets_.empty() ? 0 : this->row_offsets_.size() - 1; }
+
+ protected:
+  /**
+   * @brief Encode one row.
+   *
+   * @param src Row to encode.
+   * @param dst Destination, or nullptr to only compute the encoded size.
+   * @return Number of bytes the encoded row takes.
+   */
+  size_t encode_row_(const uint8_t *src, uint8_t *dst) const;
+
+  bool same_unit_(const uint8_t *src, size_t a, size_t b) const {
+    return memcmp(src + a * this->unit_, src + b * this->unit_, this->unit_) == 0;
+  }
+
+  RAMAllocator<uint8_t> allocator_{};
+  uint8_t *data_{nullptr};
+  size_t size_{0};
+  size_t stride_{0};
+  size_t unit_{1};
+  std::vector<uint32_t> row_offsets_;
+};
+
+}  // namespace local_image
+}  // namespace esphome
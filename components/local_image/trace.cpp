@@ -0,0 +1,88 @@
+#include "trace.h"
+#ifdef USE_LOCAL_IMAGE_TRACE
+
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+#include "esphome/core/application.h"
+#include "esphome/core/log.h"
+
+static const char *const TAG = "local_image.trace";
+
+namespace esphome {
+namespace local_image {
+
+TraceBuffer global_trace_buffer;  // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+void TraceBuffer::set_capacity(size_t capacity) {
+  std::lock_guard<std::mutex> lock(this->lock_);
+  this->events_.assign(capacity, TraceEvent{});
+  this->count_ = 0;
+}
+
+void TraceBuffer::record(const char *name, uint32_t start_us, uint32_t duration_us) {
+  // Spans of the read ahead thread show up on their own track.
+  uint32_t thread = std::hash<std::thread::id>{}(std::this_thread::get_id()) & 0xFFFF;
+  std::lock_guard<std::mutex> lock(this->lock_);
+  if (this->events_.empty()) {
+    return;
+  }
+  this->events_[this->count_ % this->events_.size()] = TraceEvent{name, start_us, duration_us, thread};
+  this->count_++;
+}
+
+void TraceBuffer::clear() {
+  std::lock_guard<std::mutex> lock(this->lock_);
+  this->count_ = 0;
+}
+
+void TraceBuffer::dump() {
+  std::vector<TraceEvent> events;
+  size_t overwritten;
+  {
+    // Copy out, so that recording is not blocked by slow output.
+    std::lock_guard<std::mutex> lock(this->lock_);
+    size_t size = std::min(this->count_, this->events_.size());
+    overwritten = this->count_ - size;
+    events.reserve(size);
+    for (size_t i = this->count_ - size; i < this->count_; i++) {
+      events.push_back(this->events_[i % this->events_.size()]);
+    }
+  }
+  if (overwritten > 0) {
+    ESP_LOGW(TAG, "%zu oldest events were overwritten", overwritten);
+  }
+
+#ifdef USE_HOST
+  FILE *file = fopen(this->file_.c_str(), "w");
+  if (file == nullptr) {
+    ESP_LOGE(TAG, "Can not write trace to %s", this->file_.c_str());
+    return;
+  }
+  fputs("{\"traceEvents\":[\n", file);
+  for (size_t i = 0; i < events.size(); i++) {
+    const TraceEvent &event = events[i];
+    fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%" PRIu32 ",\"dur\":%" PRIu32 ",\"pid\":1,\"tid\":%" PRIu32 "}%s\n",
+            event.name, event.start_us, event.duration_us, event.thread, i + 1 < events.size() ? "," : "");
+  }
+  fputs("]}\n", file);
+  fclose(file);
+  ESP_LOGD(TAG, "Wrote %zu trace events to %s", events.size(), this->file_.c_str());
+#else
+  // One event per line; concatenate the lines between '[' and ']' to get a trace file.
+  ESP_LOGI(TAG, "Trace, %zu events: {\"traceEvents\":[", events.size());
+  for (size_t i = 0; i < events.size(); i++) {
+    const TraceEvent &event = events[i];
+    ESP_LOGI(TAG, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%" PRIu32 ",\"dur\":%" PRIu32 ",\"pid\":1,\"tid\":%" PRIu32 "}%s",
+             event.name, event.start_us, event.duration_us, event.thread, i + 1 < events.size() ? "," : "");
+    App.feed_wdt();
+  }
+  ESP_LOGI(TAG, "]}");
+#endif
+}
+
+}  // namespace local_image
+}  // namespace esphome
+
+#endif  // USE_LOCAL_IMAGE_TRACE
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_LOCAL_IMAGE_TRACE
+
+#include <cinttypes>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "esphome/core/hal.h"
+
+namespace esphome {
+namespace local_image {
+
+/**
+ * @brief A completed span of the load pipeline.
+ */
+struct TraceEvent {
+  /** Static string naming the span. */
+  const char *name;
+  uint32_t start_us;
+  uint32_t duration_us;
+  uint32_t thread;
+};
+
+/**
+ * @brief Ring buffer of trace events of all images.
+ *
+ * When full, the oldest events are overwritten. dump() writes the events in the
+ * Chrome trace event format, which chrome://tracing and https://ui.perfetto.dev
+ * open: to a file on host, to the logger on devices.
+ */
+class TraceBuffer {
+ public:
+  void set_capacity(size_t capacity);
+  /** File the host build writes the trace to. */
+  void set_file(const std::string &file) { this->file_ = file; }
+
+  void record(const char *name, uint32_t start_us, uint32_t duration_us);
+  /** Write out all buffered events. */
+  void dump();
+  void clear();
+
+ protected:
+  std::mutex lock_;
+  std::vector<TraceEvent> events_;
+  /** Number of events recorded since the last clear, may exceed the capacity. */
+  size_t count_{0};
+  std::string file_{"local_image_trace.json"};
+};
+
+extern TraceBuffer global_trace_buffer;  // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+/**
+ * @brief Records the time between its construction and destruction as a trace event.
+ */
+class TraceScope {
+ public:
+  explicit TraceScope(const char *name) : name_(name), start_(micros()) {}
+  ~TraceScope() { global_trace_buffer.record(this->name_, this->start_, micros() - this->start_); }
+
+ protected:
+  const char *name_;
+  uint32_t start_;
+};
+
+}  // namespace local_image
+}  // namespace esphome
+
+#define LOCAL_IMAGE_TRACE_CONCAT_(a, b) a##b
+#define LOCAL_IMAGE_TRACE_CONCAT(a, b) LOCAL_IMAGE_TRACE_CONCAT_(a, b)
+/** Trace the rest of the enclosing block. */
+#define LOCAL_IMAGE_TRACE_SCOPE(name) \
+  ::esphome::local_image::TraceScope LOCAL_IMAGE_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#else  // USE_LOCAL_IMAGE_TRACE
+
+#define LOCAL_IMAGE_TRACE_SCOPE(name)
+
+#endif  // USE_LOCAL_IMAGE_TRACE
+
+#ifdef USE_LOCAL_IMAGE_TRACE_DRAW
+/** Trace point in the per pixel path, only with trace level DRAW. */
+#define LOCAL_IMAGE_TRACE_DRAW_SCOPE(name) LOCAL_IMAGE_TRACE_SCOPE(name)
+#else
+#define LOCAL_IMAGE_TRACE_DRAW_SCOPE(name)
+#endif